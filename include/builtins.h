@@ -21,4 +21,13 @@ Shared<Module> initBuiltins();
 namespace builtIns {
 void input(BuiltInHelper helper, int argc);
 void random(BuiltInHelper helper, int argc);
+void range(BuiltInHelper helper, int argc);
+void len(BuiltInHelper helper, int argc);
+void push(BuiltInHelper helper, int argc);
+void pop(BuiltInHelper helper, int argc);
+void insert(BuiltInHelper helper, int argc);
+void extend(BuiltInHelper helper, int argc);
+void keys(BuiltInHelper helper, int argc);
+void has(BuiltInHelper helper, int argc);
+void remove(BuiltInHelper helper, int argc);
 }  // namespace builtIns
@@ -0,0 +1,28 @@
+#pragma once
+#include "compiler/compiler.h"
+
+struct AssembledInstruction {
+    u8 instruction;
+    int start;
+    int length;
+    int target;
+    bool wide;
+};
+
+bool isJump(u8 instruction);
+bool jumpsBack(u8 instruction);
+
+// Loop jumps have a two byte slot between the instruction and its distance
+bool isLoopJump(u8 instruction);
+int instructionLength(const Chunk& chunk, int offset);
+
+// Splits a chunk into instructions, a jump's target is the index of the instruction it lands on.
+// The list ends with an empty instruction for jumps to the end of the chunk
+std::vector<AssembledInstruction> decodeChunk(const Chunk& chunk);
+
+// Writes the instructions back, removed ones have a length of zero and
+// jumps are only made wide when their distance doesn't fit into two bytes
+void encodeChunk(Chunk& chunk, std::vector<AssembledInstruction>& instructions);
+
+// Shrinks every jump that fits into two bytes, the compiler emits them all with four
+void relaxJumps(Chunk& chunk);
@@ -18,12 +18,22 @@ enum Instructions : u8 {
     OpDivide,
     OpExponent,
     OpEqual,
+    OpNotEqual,
     OpGreater,
     OpLess,
     OpGreaterThanOrEq,
     OpLessThanOrEq,
     OpNot,
     OpNegate,
+    OpAddNumbers,
+    OpSubtractNumbers,
+    OpMultiplyNumbers,
+    OpDivideNumbers,
+    OpGreaterNumbers,
+    OpLessNumbers,
+    OpGreaterThanOrEqNumbers,
+    OpLessThanOrEqNumbers,
+    OpNegateNumber,
     OpPrint,
     OpDefineGlobal,
     OpGetGlobal,
@@ -32,6 +42,12 @@ enum Instructions : u8 {
     OpSetLocal,
     OpGetProperty,
     OpSetProperty,
+    OpList,
+    OpDict,
+    OpGetIndex,
+    OpSetIndex,
+    OpSlice,
+    OpBuildString,
     OpGetUpValue,
     OpSetUpValue,
     OpPopLocals,
@@ -40,9 +56,16 @@ enum Instructions : u8 {
     OpJumpIfTrue,
     OpJumpIfFalse,
     OpJumpPopIfFalse,
+    OpGetIter,
+    OpForIter,
+    OpForRange,
+    OpForRangeLoop,
     OpFunction,
     OpCall,
+    OpInvoke,
+    OpCheckFunction,
     OpType,
     OpInherit,
-    OpBindMethod
+    OpBindMethod,
+    OpWide
 };
@@ -1,82 +1,130 @@
 #pragma once
+#include <mutex>
 #include "compiler/bytecode.h"
+#include "compiler/constants.h"
+#include "compiler/resolver.h"
 #include "syntax/ast.h"
 #include "syntax/scanner.h"
+#include "threadpool.h"
 #include "util.h"
 #include "error.h"
 
+const int parallel_compile_threshold = 64;
+
+struct CompileOptions {
+    bool lazy = false;
+    bool showStats = false;
+    int optimizeLevel = 0;
+    bool dumpIr = false;
+};
+
 struct Prototype;
 
-struct ConstantPool {
-    std::vector<double> numbers;
-    std::vector<std::string> names;
-    std::vector<Prototype> prototypes;
+struct InlineTarget {
+    FuncDeclaration* decl;
+    std::weak_ptr<Prototype> prot;
+};
+
+// Top level functions that are only declared once, calls to them can be inlined
+using InlineTable = std::unordered_map<std::string, InlineTarget>;
+
+// The shape a property instruction last saw, filled in by the interpreter. Shapes belong to
+// one type, so the slot is either a field or an index into that type's method table
+struct InlineCache {
+    Shared<struct Shape> shape;
+    Shared<struct Shape> next;  // Set when the store adds the field
+    u16 slot = 0;
+    bool method = false;
 };
 
 struct Chunk {
     std::vector<u8> bytecode;
     std::vector<std::pair<int, SourceView>> markers;
-    ConstantPool constants;
+    Shared<ConstantPool> constants;
+    std::vector<Shared<Prototype>> prototypes;
+    std::vector<InlineCache> caches;
+};
+
+struct LazyFunction {
+    Shared<Ast> ast;
+    FuncDeclaration* decl;
+    std::string path;
+    CompileOptions options;
+    Shared<InlineTable> inlineTable;
 };
 
 struct Prototype {
     std::string name;
     u8 argc;
-    u8 upValues;
+    u16 upValues;
+    u16 slots;
     Chunk chunk;
-};
-
-struct Local {
-    std::string name;
-    int depth;
-};
-
-struct UpValueData {
-    u8 index;
-    bool isLocal;
+    Shared<LazyFunction> lazy;
 };
 
 struct LoopData;
-struct ChunkData;
 
 struct ChunkData {
+    std::string name;
     int scopeDepth;
-    int localOffset;
+    int slots;
     bool global;
+    bool initializer;
     Chunk chunk;
     std::vector<Local> locals;
-    std::vector<UpValueData> upValues;
     std::unique_ptr<LoopData> loopData;
-    std::unique_ptr<ChunkData> enclosing;
 };
 
+// Continues jump back to start, or forwards to wherever the loop steps when start is -1
 struct LoopData {
     std::unique_ptr<LoopData> enclosing;
     int start;
+    int scopeDepth;
     std::vector<int> breaks;
+    std::vector<int> continues;
+};
+
+struct CompileContext {
+    bool parallel;
+    CompileOptions options;
+    Shared<Ast> ast;
+    Resolution resolution;
+    Shared<InlineTable> inlineTable;
+    std::unordered_map<const FuncDeclaration*, Shared<Prototype>> prototypes;
+    std::mutex mutex;
+    std::vector<Error> errors;
+    ThreadPool::Group tasks;
 };
 
 class Compiler {
 public:
-    Compiler(std::string& path) : path(path) {};
+    Compiler(std::string& path, CompileOptions options = {}) : options(options), path(path) {};
 
-    Chunk compile(Ast& ast);
+    Chunk compile(Shared<Ast> ast);
+    bool compileLazy(Prototype& prot);
     bool failed();
     Error getError();
 
-private:
+protected:
+    Compiler(std::string& path, Shared<CompileContext> context) : options(context->options), path(path), context(context) {};
+
     // Chunk
     Chunk* getChunk();
     void newChunk();
     Chunk endChunk();
+    void function(FuncDeclaration& stmt, Prototype& prot);
+    void collectInlineTargets(Ast& ast);
+    void collectErrors();
 
     // Scope
     void beginScope();
     void endScope();
 
     // Loop
-    void beginLoop();
+    void beginLoop(int start);
     void endLoop();
+    void popLoopLocals();
+    void patchContinues();
 
     // Error
     void errorAt(SourceView token, std::string msg, std::string note="");
@@ -87,10 +135,7 @@ private:
     int makeNameConstant(std::string value, SourceView view);
 
     // Locals
-    void addLocal(std::string name, SourceView view);
-    int addUpValue(std::unique_ptr<ChunkData>& chunk, u8 index, bool isLocal, SourceView view);
-    int findLocal(std::unique_ptr<ChunkData>& chunk, std::string name);
-    int findUpValue(std::unique_ptr<ChunkData>& chunk, std::string name, SourceView view);
+    void addLocal(std::string name);
 
     // Variables
     void declare(std::string name, SourceView view);
@@ -100,28 +145,37 @@ private:
     void breakStmt(BreakStmt& stmt);
     void continueStmt(ContinueStmt& stmt);
     void exitStmt(ExitStmt& stmt);
-    void returnStmt(Ptr<ReturnStmt> stmt);
+    void returnStmt(Ptr<ReturnStmt>& stmt);
     void printStmt(Ptr<PrintStmt>& stmt);
     void ifStmt(Ptr<IfStmt>& stmt);
     void loopBlock(Ptr<LoopBlock>& stmt);
     void whileLoop(Ptr<WhileLoop>& stmt);
     void forLoop(Ptr<ForLoop>& stmt);
+    void rangeLoop(ForLoop& stmt, int slot);
+    void iteratorLoop(ForLoop& stmt, int slot);
     void typeDeclaration(Ptr<TypeDeclaration>& stmt);
     void funcDeclaration(Ptr<FuncDeclaration>& stmt);
+    Shared<Prototype> emitPrototype(FuncDeclaration& stmt);
+    void compileBody(FuncDeclaration& stmt, Shared<Prototype> prot);
     void varDeclaration(Ptr<VarDeclaration>& stmt);
 
     // Expressions
-    void expression(Expr expr);
+    void expression(Expr& expr);
     void assignment(Ptr<AssignmentExpr>& assignment);
     void identifier(Identifier& id, bool get);
 
     // Emit Byte
     void emitByte(u8 value);
     void emitByte(u16 value);
+    void emitByte(u32 value);
     template <typename First>
     void emitByte(First value);
     template <typename First, typename... Rest>
     void emitByte(First byte, Rest... rest);
+    void emitInstruction(u8 instruction, int operand);
+    void emitOperand(int operand, bool wide);
+    void emitFunction(int index, std::vector<UpValueData>& upValues);
+    void emitProperty(u8 instruction, int name);
 
     // Marker
     void marker(SourceView& view);
@@ -130,9 +184,24 @@ private:
     void emitJumpBackwards(u8 jump, int where);
     int emitJumpForwards(u8 jump);
     void patchJump(int index);
+    void emitLoopJumpBackwards(u8 jump, int where, int slot);
+    int emitLoopJumpForwards(u8 jump, int slot);
 
     bool hadError;
+    CompileOptions options;
     Error error;
     std::string& path;
+    Shared<CompileContext> context;
     std::unique_ptr<ChunkData> chunkData;
 };
+
+template <typename First>
+void Compiler::emitByte(First value) {
+    emitByte((u8)value);
+}
+
+template <typename First, typename... Rest>
+void Compiler::emitByte(First byte, Rest... rest) {
+    emitByte(byte);
+    emitByte(rest...);
+}
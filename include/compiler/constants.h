@@ -0,0 +1,27 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Whole numbers up to 255 are stored in the instruction instead of the pool, -0 has to stay in the pool
+inline bool fitsInByte(double value) {
+    return value >= 0 && value <= UINT8_MAX && value == (int)value && !std::signbit(value);
+}
+
+// One pool per compiled module, shared by all of its chunks
+class ConstantPool {
+public:
+    std::vector<double> numbers;
+    std::vector<std::string> names;
+
+    int addNumber(double value);
+    int addName(const std::string& value);
+
+private:
+    std::shared_mutex mutex;
+    std::unordered_map<uint64_t, int> numberIndices;
+    std::unordered_map<std::string, int> nameIndices;
+};
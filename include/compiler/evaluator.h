@@ -0,0 +1,42 @@
+#pragma once
+#include "compiler/folder.h"
+
+const int evaluate_steps_max = 10000;
+const int evaluate_depth_max = 16;
+const int evaluate_string_max = 4096;
+const int evaluate_source_max = 4096;
+
+// A sandboxed interpreter over the ast that runs pure functions on constants while compiling,
+// it gives up on anything that would error at runtime or doesn't finish within its budget
+class Evaluator {
+public:
+    Evaluator(Folder& folder) : folder(folder) {};
+
+    bool call(FuncDeclaration& func, std::vector<Expr>& args, Expr& result);
+
+private:
+    enum class Flow {
+        Next,
+        Break,
+        Continue,
+        Return,
+        Fail
+    };
+
+    // Scope
+    void beginScope();
+    void endScope();
+    Expr* lookup(std::string& name);
+
+    // Nodes
+    Flow body(std::vector<Stmt>& stmts);
+    Flow statement(Stmt& stmt);
+    Flow loop(Expr* condition, std::vector<Stmt>& stmts);
+    bool expression(Expr& expr, Expr& result);
+
+    Folder& folder;
+    int steps = 0;
+    int depth = 0;
+    Expr returnValue;
+    std::vector<std::vector<std::pair<std::string, Expr>>> scopes;
+};
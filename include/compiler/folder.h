@@ -0,0 +1,51 @@
+#pragma once
+#include <unordered_map>
+#include <unordered_set>
+#include "syntax/ast.h"
+
+// Evaluates constant expressions and drops branches that can never run before the ast is resolved,
+// calls to pure functions with constant arguments are run right away by the evaluator
+class Folder {
+public:
+    Folder(Ast& ast, std::string& path) : ast(ast), path(path) {};
+
+    void fold();
+    void foldFunction(FuncDeclaration& stmt);
+    FuncDeclaration* pureFunction(Expr& target);
+
+    // Constants
+    static bool isConstant(Expr& expr);
+    static bool isTruthy(Expr& expr);
+    static bool constantsEqual(Expr& a, Expr& b);
+    static bool foldBinary(BinaryExpr::Operation op, Expr& left, Expr& right, SourceView view, Expr& result);
+    static bool foldUnary(UnaryExpr::Operation op, Expr& operand, SourceView view, Expr& result);
+
+private:
+    // Nodes
+    void body(std::vector<Stmt>& stmts);
+    bool statement(Stmt& stmt, std::vector<Stmt>& out);
+    void expression(Expr& expr);
+    void binaryExpr(Expr& expr);
+    void unaryExpr(Expr& expr);
+    void callExpr(Expr& expr);
+    void formatExpr(Expr& expr);
+    void identifier(Expr& expr);
+    void globalConstant(VarDeclaration& var);
+    bool isRange(Expr& iterator);
+
+    // Pure functions
+    void findGlobals();
+    void findBindings(std::vector<Stmt>& stmts);
+    void findBindings(Stmt& stmt);
+    void findBindings(Expr& expr);
+    FuncDeclaration* callee(Expr& target);
+    bool isPure(FuncDeclaration& stmt);
+    bool isPure(std::vector<Stmt>& stmts, std::unordered_map<std::string, bool>& locals);
+    bool isPure(Expr& expr, std::unordered_map<std::string, bool>& locals);
+
+    Ast& ast;
+    std::string& path;
+    std::unordered_map<FuncDeclaration*, bool> purity;
+    std::unordered_set<FuncDeclaration*> visiting;
+    std::unordered_set<FuncDeclaration*> folding;
+};
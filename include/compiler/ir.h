@@ -0,0 +1,168 @@
+#pragma once
+#include <unordered_map>
+#include "compiler/compiler.h"
+
+// Callees are only inlined while their bodies stay this small
+const int inline_cost_max = 32;
+const int inline_source_max = 1024;
+
+enum IrOp : u8 {
+    IrParam,
+    IrNumber,
+    IrString,
+    IrTrue,
+    IrFalse,
+    IrNone,
+    IrPhi,
+    IrAdd,
+    IrSubtract,
+    IrModulous,
+    IrMultiply,
+    IrDivide,
+    IrExponent,
+    IrEqual,
+    IrNotEqual,
+    IrGreater,
+    IrLess,
+    IrGreaterThanOrEq,
+    IrLessThanOrEq,
+    IrNot,
+    IrNegate,
+    IrGetGlobal,
+    IrSetGlobal,
+    IrGetUpValue,
+    IrSetUpValue,
+    IrGetProperty,
+    IrSetProperty,
+    IrCall,
+    IrInvoke,
+    IrCheckFunction,
+    IrPrint,
+
+    // Terminators
+    IrJump,
+    IrBranch,
+    IrReturn,
+    IrExit
+};
+
+struct IrInstruction {
+    IrOp op;
+    int block;
+    int operand;
+    double number;
+    std::vector<int> args;
+    SourceView view;
+    bool removed;
+    SourceView callee = {};  // Calls mark their target separately, like the ast compiler does
+};
+
+// Phis come first and the terminator last, a branch goes to succs[0] when its condition is truthy
+struct IrBlock {
+    std::vector<int> instructions;
+    std::vector<int> preds;
+    std::vector<int> succs;
+    bool removed;
+};
+
+struct IrFunction {
+    std::string name;
+    int argc;
+    std::vector<IrInstruction> instructions;
+    std::vector<IrBlock> blocks;
+    std::vector<Shared<Prototype>> prototypes;
+};
+
+bool isConstant(IrOp op);
+bool isTerminator(IrOp op);
+bool producesValue(IrOp op);
+bool hasSideEffects(IrOp op);
+
+int terminator(IrFunction& func, int block);
+std::vector<int> countUses(IrFunction& func);
+
+// Passes collect their changes and apply them in one sweep, so a pass stays linear in the function's size
+int resolveReplacement(std::vector<int>& replacements, int value);
+void replaceUses(IrFunction& func, std::vector<int>& replacements);
+void removeMarked(IrFunction& func);
+
+// Block orders and dominators only cover blocks reachable from the entry
+std::vector<int> reversePostorder(IrFunction& func);
+std::vector<int> immediateDominators(IrFunction& func);
+bool dominates(std::vector<int>& idoms, int a, int b);
+
+// Which values are known to be numbers, anything else could be any type
+std::vector<bool> inferNumbers(IrFunction& func);
+bool canTrap(IrFunction& func, std::vector<bool>& numbers, int index);
+
+void removeUnreachableBlocks(IrFunction& func);
+void splitCriticalEdges(IrFunction& func);
+
+// Builds ssa form straight from the ast, fails on anything it doesn't handle so the
+// function can be compiled the usual way instead
+class IrBuilder {
+public:
+    IrBuilder(CompileContext& context, std::string& path) : path(path), context(context), resolution(context.resolution) {};
+
+    bool build(FuncDeclaration& stmt, IrFunction& func);
+
+private:
+    // Blocks
+    int newBlock();
+    void sealBlock(int block);
+    bool isTerminated();
+    void jump(int target);
+    void branch(int condition, int ifTrue, int ifFalse);
+    void unreachable();
+
+    // Instructions
+    int emit(IrOp op, std::vector<int> args = {}, int operand = 0, SourceView view = {});
+    int number(double value);
+    int phi(int block);
+
+    // Variables
+    void beginScope();
+    void endScope();
+    int declare(std::string& name);
+    void writeVariable(int slot, int block, int value);
+    int readVariable(int slot, int block);
+    int readVariableRecursive(int slot, int block);
+    void addPhiOperands(int slot, int phi);
+
+    // Nodes
+    void body(std::vector<Stmt>& stmts);
+    void statement(Stmt& stmt);
+    void ifStmt(IfStmt& stmt);
+    void loop(Expr* condition, std::vector<Stmt>& stmts);
+    int expression(Expr& expr);
+    int assignment(AssignmentExpr& assignment);
+    int logical(BinaryExpr& binary);
+    int binary(BinaryExpr& binary);
+
+    // Inlining
+    FuncDeclaration* inlineTarget(CallExpr& call);
+    int inlineCall(FuncDeclaration& callee, std::vector<int>& args, CallExpr& call);
+
+    struct Loop {
+        int header;
+        int exit;
+    };
+
+    bool failed;
+    int current;
+    int scopeDepth;
+    int slotBase;
+    int inlineCount;
+    int returnBlock;
+    FuncDeclaration* function;
+    IrFunction* func;
+    std::string& path;
+    CompileContext& context;
+    Resolution& resolution;
+    std::vector<int> returns;
+    std::vector<Local> locals;
+    std::vector<Loop> loops;
+    std::vector<bool> sealed;
+    std::vector<std::unordered_map<int, int>> definitions;
+    std::vector<std::unordered_map<int, int>> incompletePhis;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "compiler/compiler.h"
+#include "compiler/ir.h"
+
+// Compiles a function body through the ir so it can be optimized, values that are used
+// once right where they are made stay on the stack and everything else gets a local slot
+class IrCompiler : public Compiler {
+public:
+    IrCompiler(std::string& path, Shared<CompileContext> context) : Compiler(path, context) {};
+
+    bool compileFunction(FuncDeclaration& stmt, Prototype& prot);
+
+private:
+    // Slots
+    bool isEmitted(int index);
+    bool needsSlot(int index);
+    void stackify();
+    void allocateSlots();
+
+    // Blocks
+    void block(int index);
+    void terminate(int index);
+    void phiCopies(int from, int to);
+    void jumpTo(int target, bool force = false);
+
+    // Values
+    void tree(int index);
+    void argument(int index);
+    void load(int index);
+    void operation(int index);
+    bool numeric(IrInstruction& inst);
+
+    IrFunction ir;
+    int currentBlock;
+    int slotCount;
+    std::vector<int> layout;
+    std::vector<int> position;
+    std::vector<int> uses;
+    std::vector<int> slots;
+    std::vector<bool> stacked;
+    std::vector<bool> numbers;
+    std::vector<int> starts;
+    std::vector<std::vector<int>> pendingJumps;
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include "compiler/ir.h"
+
+struct IrPass {
+    const char* name;
+    int level;
+    void (*run)(IrFunction& func);
+};
+
+// Passes run in order, each one only once the optimization level reaches its own.
+// New passes are added before any code is compiled
+std::vector<IrPass>& irPipeline();
+void optimizeIr(IrFunction& func, int level);
+
+// Passes
+void propagateCopies(IrFunction& func);
+void eliminateCommonSubexpressions(IrFunction& func);
+void hoistLoopInvariants(IrFunction& func);
+void eliminateDeadCode(IrFunction& func);
@@ -0,0 +1,5 @@
+#pragma once
+#include "compiler/compiler.h"
+
+// Rewrites a finished chunk into cheaper instruction sequences and relaxes its jumps
+void optimizeChunk(Chunk& chunk);
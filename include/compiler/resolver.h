@@ -0,0 +1,100 @@
+#pragma once
+#include <unordered_map>
+#include <unordered_set>
+#include "compiler/constants.h"
+#include "syntax/ast.h"
+#include "util.h"
+#include "error.h"
+
+struct Local {
+    std::string name;
+    int depth;
+    bool constant = false;
+};
+
+struct UpValueData {
+    u16 index;
+    bool isLocal;
+};
+
+struct Variable {
+    enum Kind {
+        Local,
+        UpValue,
+        Global
+    };
+
+    Kind kind;
+    int index;
+};
+
+struct Resolution {
+    int functionCount = 0;
+    Shared<ConstantPool> constants;
+    std::unordered_map<const Identifier*, Variable> variables;
+    std::unordered_map<const FuncDeclaration*, std::vector<UpValueData>> upValues;
+
+    // Where each constant global is declared, so later bodies can't assign to it
+    std::unordered_map<std::string, int> constantGlobals;
+};
+
+struct ResolverData {
+    int scopeDepth;
+    int localOffset;
+    std::vector<Local> locals;
+    std::vector<UpValueData> upValues;
+    std::unique_ptr<ResolverData> enclosing;
+};
+
+class Resolver {
+public:
+    Resolver(std::string& path, bool lazy = false) : lazy(lazy), path(path) {};
+
+    void resolve(Ast& ast, Resolution& resolution);
+    void resolveFunction(Ast& ast, FuncDeclaration& stmt, Resolution& resolution);
+    bool failed();
+    Error getError();
+
+private:
+    // Function
+    void declareConstants(Ast& ast);
+    void newFunction();
+    std::vector<UpValueData> endFunction();
+
+    // Scope
+    void beginScope();
+    void endScope();
+
+    // Error
+    void errorAt(SourceView view, std::string msg, std::string note="");
+
+    // Locals
+    void addLocal(std::string name, SourceView view, bool constant = false);
+    int addUpValue(std::unique_ptr<ResolverData>& data, u16 index, bool isLocal, SourceView view);
+    int findLocal(std::unique_ptr<ResolverData>& data, std::string& name);
+    int findUpValue(std::unique_ptr<ResolverData>& data, std::string& name, SourceView view);
+
+    // Constants
+    void addNumber(double value);
+    void addName(const std::string& value);
+
+    // Variables
+    void declare(std::string name, SourceView view, bool constant = false);
+    void identifier(Identifier& id);
+    bool isConstant(std::string& name);
+
+    // Nodes
+    void body(std::vector<Stmt>& stmts);
+    void forLoop(ForLoop& stmt);
+    void typeDeclaration(TypeDeclaration& stmt);
+    void methodDeclaration(FuncDeclaration& stmt);
+    void funcDeclaration(FuncDeclaration& stmt);
+    void expression(Expr& expr);
+
+    bool hadError;
+    bool lazy;
+    Error error;
+    std::string& path;
+    Resolution* resolution;
+    std::unique_ptr<ResolverData> data;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include "compiler/compiler.h"
+#include "syntax/scanner.h"
+
+// What the single pass compiler still knows about an expression after emitting it
+struct EmittedExpr {
+    enum Kind {
+        Other,
+        Literal,
+        Name,
+        Property
+    };
+
+    Kind kind;
+    int start;
+    int end;
+    Token token;
+};
+
+struct EnclosingFunction {
+    std::unique_ptr<ChunkData> chunkData;
+    std::vector<UpValueData> upValues;
+};
+
+// Compiles straight from the token stream without building an ast, it emits the same
+// bytecode as the ast compiler (only negative literals are folded) and fails on anything
+// it doesn't handle (including errors)
+class SinglePassCompiler : public Compiler {
+public:
+    SinglePassCompiler(std::string& src, std::string& path, CompileOptions options = {}) : Compiler(path, options), scanner(src) {};
+
+    Chunk compile();
+
+private:
+    // Tokens
+    void advance();
+    void consume(TokenType type);
+    bool isFinished();
+    bool check(TokenType type);
+    bool match(TokenType type);
+
+    template <typename... Args>
+    bool match(TokenType type, Args... args);
+
+    void unsupported();
+
+    // Function
+    void beginFunction();
+    std::vector<UpValueData> endFunction(Prototype& prot);
+
+    // Bytecode
+    int offset();
+    void insertMarker(int where, SourceView view);
+    void moveToEnd(int from, int to);
+    void copyToEnd(int from, int to);
+    void truncate(int where);
+
+    // Variables
+    void declareChecked(Token& name);
+    int findLocal(ChunkData& data, std::string& name);
+    int findUpValue(int depth, std::string& name);
+    int addUpValue(int depth, u16 index, bool isLocal);
+    void variable(Token& name, bool get);
+
+    // Statements
+    void statement();
+    void block();
+    void printStmt();
+    void ifStmt();
+    void loopBlock();
+    void whileLoop();
+    void returnStmt();
+    void funcDeclaration();
+    void varDeclaration();
+
+    // Expressions
+    EmittedExpr expression();
+    EmittedExpr _or();
+    EmittedExpr _and();
+    EmittedExpr equality();
+    EmittedExpr comparison();
+    EmittedExpr term();
+    EmittedExpr factor();
+    EmittedExpr exponent();
+    EmittedExpr unary();
+    EmittedExpr post();
+    EmittedExpr primary();
+    void binary(Token& op, int start);
+    void emitOperator(TokenType type);
+
+    Token cur;
+    Token prev;
+    Scanner scanner;
+    std::vector<UpValueData> upValues;
+    std::vector<EnclosingFunction> enclosing;
+};
@@ -25,26 +25,42 @@ public:
     int pc();
     u8 readByte();
     u16 readShort();
+    u16 readOperand();
+    u32 readJump();
     Number readNumberConstant();
-    String readNameConstant();
+    std::string readNameConstant();
     void push(Value value);
     Value pop();
     Value peek(int offset);
+    bool findProperty(Instance& instance, const std::string& name, InlineCache& cache);
     bool callValue(Value value);
+    bool callFunction(Shared<Function> func, u8 argc);
+    bool compileLazy(Prototype& prot);
     CallFrame* getFrame();
     void newFrame(Shared<Module> mod, Chunk& chunk, Value* sp, Shared<Function> func);
     Shared<UpValue> captureUpValue(Value* local);
     void closeUpValues(Value* minLoc);
     void printStack();
 
+    // Iteration, the state starts out as whatever getIterator gives back
+    bool getIterator(Value& iterable, Value& state);
+    bool iterate(Value& iterable, Value& state, Value& result);
+
+    // Negative indices count back from the end
+    bool getIndex(Value& index, size_t size, size_t& result);
+    bool getSliceBound(Value& bound, size_t size, size_t fallback, size_t& result);
+    bool hashKey(Value& key, size_t& hash);
+
     bool valuesEqual(Value& a, Value& b);
     bool isTruthy(Value& value);
 
     bool hadError;
+    bool wide;
     Error error;
     State& state;
 
     Shared<UpValue> openUpValues;
     std::vector<Value> stack;
     std::vector<CallFrame> frames;
+    OutputBuffer output;
 };
\ No newline at end of file
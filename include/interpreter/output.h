@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "variant.h"
+
+const size_t output_buffer_size = 1 << 16;
+
+// Where print output ends up, hosts embedding the interpreter can hand State their own
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    virtual void write(const char* data, size_t length) = 0;
+    virtual void flush() {}
+
+    // Interactive sinks get every line as soon as it's printed
+    virtual bool interactive() { return false; }
+};
+
+class StdoutSink : public OutputSink {
+public:
+    void write(const char* data, size_t length) override;
+    void flush() override;
+    bool interactive() override;
+};
+
+// Print statements write here, the sink only sees large writes unless it's interactive
+class OutputBuffer {
+public:
+    OutputBuffer(Shared<OutputSink> sink);
+    ~OutputBuffer();
+
+    void write(std::string_view text);
+    void endLine();
+    void flush();
+
+private:
+    Shared<OutputSink> sink;
+    std::string buffer;
+    bool lineBuffered;
+};
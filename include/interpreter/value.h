@@ -1,4 +1,5 @@
 #pragma once
+#include <string_view>
 #include "compiler/compiler.h"
 #include "util.h"
 #include "variant.h"
@@ -8,9 +9,26 @@ class BuiltInHelper;
 struct None {};
 
 using Number = double;
-using String = std::string;
 using Boolean = bool;
 
+// Strings are a length into a shared buffer. Concatenating onto a string that still ends where its
+// buffer does appends in place, so building one up in a loop is linear instead of quadratic
+struct String {
+    Shared<std::string> buffer;
+    size_t length;
+
+    String(std::string str);
+    String(const char* str);
+
+    size_t size() const { return length; }
+    char operator[](size_t index) const { return (*buffer)[index]; }
+    bool operator==(const String& other) const { return view() == other.view(); }
+
+    std::string_view view() const;
+    std::string str() const;
+    String concat(const String& other) const;
+};
+
 using Value = Variant<
     None,
     Number,
@@ -19,7 +37,13 @@ using Value = Variant<
     Shared<struct UpValue>,
     Shared<struct Function>,
     Shared<struct BuiltInFunction>,
-    Shared<struct Module>>;
+    Shared<struct Module>,
+    Shared<struct Range>,
+    Shared<struct List>,
+    Shared<struct Dict>,
+    Shared<struct Type>,
+    Shared<struct Instance>,
+    Shared<struct BoundMethod>>;
 
 using BuiltInFunctionPtr = void (*)(BuiltInHelper helper, int argc);
 
@@ -35,7 +59,7 @@ struct UpValue {
 };
 
 struct Function {
-    Prototype prot;
+    Shared<Prototype> prot;
     Shared<Module> mod;
     std::vector<Shared<UpValue>> upValues;
 };
@@ -44,3 +68,102 @@ struct Module {
     std::string name;
     std::map<std::string, Value> globals;
 };
+
+// Only made when range is called outside of a for loop, loops over it count without one
+struct Range {
+    Number start;
+    Number end;
+    Number step;
+};
+
+// Lists of nothing but numbers keep them unboxed, the first other value moves every item into values
+struct List {
+    bool boxed = false;
+    std::vector<Number> numbers;
+    std::vector<Value> values;
+
+    size_t size() const;
+    Value get(size_t index) const;
+    void set(size_t index, Value value);
+    void push(Value value);
+    void insert(size_t index, Value value);
+    Value pop();
+    void extend(const List& other);
+    Shared<List> slice(size_t start, size_t end) const;
+    void box();
+};
+
+// Robin Hood hashing over slots that point into entries, which keep insertion order. Every entry and
+// slot keeps its key's hash so growing never rehashes and most mismatches never compare the keys
+struct Dict {
+    struct Entry {
+        Value key;
+        Value value;
+        size_t hash;
+        size_t order;  // Counts every key ever added, compacting keeps it so loops can find their place
+        bool removed;
+    };
+
+    struct Slot {
+        u32 entry;  // One past the entry's index, zero when empty
+        u32 hash;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Slot> slots;
+    size_t count = 0;
+    size_t added = 0;
+
+    // Only numbers, strings, booleans and None can be keys
+    static bool hashKey(const Value& key, size_t& hash);
+
+    size_t size() const;
+    Value* find(const Value& key, size_t hash);
+    void set(const Value& key, size_t hash, Value value);
+    bool remove(const Value& key, size_t hash);
+
+    // Index of the first live entry added at or after the given order
+    size_t next(size_t order) const;
+
+private:
+    int findSlot(const Value& key, size_t hash) const;
+    void place(u32 entry, u32 hash);
+    void rebuild(size_t capacity);
+};
+
+// Instances that had the same fields added in the same order share a shape, adding a
+// field moves an instance along the transition to the next one
+struct Shape {
+    std::unordered_map<std::string, u16> slots;
+    std::unordered_map<std::string, Shared<Shape>> transitions;
+
+    Shared<Shape> transition(const std::string& name);
+};
+
+// Methods are copied down into one flat table when the type is made, so finding one
+// never walks the parents. The table follows the C3 linearization of the parents
+struct Type {
+    std::string name;
+    Shared<Shape> shape;  // Every type starts from its own empty shape
+    std::vector<Shared<Type>> parents;
+    std::vector<Shared<Type>> ancestors;  // Linearized, nearest first and without the type itself
+    std::unordered_map<std::string, Shared<Function>> declared;
+    std::unordered_map<std::string, u16> slots;
+    std::vector<Shared<Function>> methods;
+
+    // False when the parents have no consistent order
+    bool inherit(std::vector<Shared<Type>> parents);
+    void bind(const std::string& name, Shared<Function> method);
+    Shared<Function> findMethod(const std::string& name);
+};
+
+struct Instance {
+    Shared<Type> type;
+    Shared<Shape> shape;
+    std::vector<Value> fields;
+};
+
+struct BoundMethod {
+    Value receiver;
+    Shared<Function> method;
+};
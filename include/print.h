@@ -1,5 +1,6 @@
 #pragma once
 #include "compiler/compiler.h"
+#include "compiler/ir.h"
 #include "interpreter/value.h"
 #include "syntax/ast.h"
 #include "syntax/scanner.h"
@@ -12,4 +13,5 @@ void printToken(const Token& token);
 void printError(const Error& error, const std::string& source);
 void printAst(const Ast& ast);
 void printChunk(const Chunk& chunk, std::string name = "");
+void printIr(const IrFunction& func);
 void printValue(const Value& value);
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <map>
+#include "interpreter/output.h"
 #include "interpreter/value.h"
 
 enum ExitCode : int {
@@ -11,10 +12,24 @@ struct Result {
     int exitCode;
 };
 
+struct Options {
+    bool lazyCompile = false;
+    bool singlePass = false;
+    bool showTimings = false;
+    bool showChunkStats = false;
+    int optimizeLevel = 0;
+    bool dumpIr = false;
+};
+
 class State {
 public:
     Shared<Module> base;
+    Options options;
+    Shared<OutputSink> output = std::make_shared<StdoutSink>();
 
     State();
     Result run(std::string source);
+
+private:
+    Result execute(Chunk& chunk, std::string& source);
 };
\ No newline at end of file
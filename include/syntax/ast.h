@@ -1,4 +1,6 @@
 #pragma once
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "variant.h"
 #include "token.h"
@@ -46,7 +48,12 @@ using Expr = Variant<
     Ptr<struct BinaryExpr>,
     Ptr<struct UnaryExpr>,
     Ptr<struct CallExpr>,
-    Ptr<struct PropertyExpr> >;
+    Ptr<struct PropertyExpr>,
+    Ptr<struct ListExpr>,
+    Ptr<struct DictExpr>,
+    Ptr<struct IndexExpr>,
+    Ptr<struct SliceExpr>,
+    Ptr<struct FormatExpr> >;
 
 using Stmt = Variant<
     Empty,
@@ -65,9 +72,25 @@ using Stmt = Variant<
     Ptr<struct BlockStmt>,
     Ptr<struct TypeDeclaration> >;
 
+// A top level variable that's never assigned again, the value is only filled in once the folder
+// has seen its declaration and only if that turned out to be a literal or a known function
+struct GlobalConstant {
+    struct VarDeclaration* decl;
+    Expr value;
+};
+
 struct Ast {
     std::string source;
     std::vector<Stmt> body;
+
+    // Top level names that aren't bound anywhere else, found by the folder before it starts
+    bool globalsFound = false;
+    std::unordered_map<std::string, int> bindings;
+    std::unordered_map<std::string, struct FuncDeclaration*> functions;
+    std::unordered_map<std::string, GlobalConstant> constants;
+
+    // Every name used in a function body that was skipped by pre-parsing
+    std::unordered_set<std::string> skippedNames;
 };
 
 // Expressions
@@ -122,6 +145,32 @@ struct PropertyExpr : AstNode {
     Identifier prop;
 };
 
+struct ListExpr : AstNode {
+    std::vector<Expr> items;
+};
+
+// Text parts are string literals, everything else is converted like print does
+struct FormatExpr : AstNode {
+    std::vector<Expr> parts;
+};
+
+struct DictExpr : AstNode {
+    std::vector<Expr> keys;
+    std::vector<Expr> values;
+};
+
+struct IndexExpr : AstNode {
+    Expr expr;
+    Expr index;
+};
+
+// Either bound is Empty when it is left out
+struct SliceExpr : AstNode {
+    Expr expr;
+    Expr start;
+    Expr end;
+};
+
 // Statements
 
 struct ExprStmt : AstNode {
@@ -151,6 +200,9 @@ struct ForLoop : AstNode {
     Identifier target;
     Expr iterator;
     std::vector<Stmt> body;
+
+    // Set by the folder when the iterator is a call to the builtin range, the loop then counts in place
+    bool range = false;
 };
 
 struct ReturnStmt : AstNode {
@@ -171,11 +223,17 @@ struct FuncDeclaration : AstNode {
     Identifier name;
     std::vector<Identifier> args;
     std::vector<Stmt> body;
+    bool preparsed = false;
+    SourceView bodyView = {};
+
+    // Methods get the instance they are called on in slot 0, as self
+    bool method = false;
 };
 
 struct VarDeclaration : AstNode {
     Identifier target;
     Expr expr;
+    bool constant = false;
 };
 
 SourceView getSourceView(Expr& expr);
@@ -5,14 +5,18 @@
 
 class Parser {
 public:
-    Parser(std::string& src, std::string& path);
+    Parser(std::string& src, std::string& path, bool lazy = false);
+    Parser(std::string& src, std::string& path, SourceView range);
 
     Ast parse();
+    std::vector<Stmt> parseBody();
+    Expr parseExpression();
     bool failed();
     Error getError();
 
 private:
     void advance();
+    Token nextToken();
     void errorAt(Token& token, std::string msg, std::string note="");
     void errorAtView(SourceView view, std::string msg, std::string note="");
     void consume(TokenType type, std::string msg);
@@ -38,11 +42,17 @@ private:
 
     NumLiteral number();
     StrLiteral string();
+    Expr formatString();
     Identifier identifer();
     Expr grouping();
+    Expr list();
+    Expr dict();
+    Expr subscript(SourceView view, Expr& expr);
 
     std::vector<Expr> exprList();
     std::vector<Stmt> block();
+    void skipBlock();
+    void skipFormatString(Token& token);
 
     Stmt statement();
     Stmt exprStmt();
@@ -54,16 +64,20 @@ private:
     Stmt returnStmt();
 
     Stmt typeDeclaration();
-    Stmt funcDeclaration();
+    Stmt funcDeclaration(bool preparse = false);
     Stmt methodDeclaration();
     Stmt varDeclaration();
 
 private:
     bool hadError;
+    bool lazy;
     Error error;
     Token cur;
     Token prev;
     Scanner scanner;
+    std::vector<Token> tokens;
+    std::unordered_set<std::string> skippedNames;
+    size_t tokenIndex;
     std::string& source;
     std::string& path;
 };
\ No newline at end of file
@@ -1,12 +1,18 @@
 #pragma once
 #include <sstream>
+#include <vector>
 #include "token.h"
 
+const int parallel_scan_threshold = 1 << 18;
+const int parallel_scan_min_chunk = 1 << 16;
+
 class Scanner {
 public:
     Scanner(std::string& src);
+    Scanner(std::string& src, int begin, int end, int line);
 
     Token nextToken();
+    std::vector<Token> scanAll();
 
 private:
     char advance();
@@ -20,11 +26,18 @@ private:
 
     Token scanNumber();
     Token scanString();
+    Token scanFormatString();
     Token scanIdentifer();
 
     int line;
     char* start;
     char* current;
     char* lineStart;
+    char* end;
     std::string& source;
-};
\ No newline at end of file
+};
+
+std::vector<Token> scanParallel(std::string& src);
+
+// Index of the brace closing the format string expression opened at open, or the closing quote if there is none
+size_t formatExpressionEnd(const std::string& value, size_t open);
\ No newline at end of file
@@ -13,6 +13,8 @@ enum class TokenType {
     RightParen,
     LeftBrace,
     RightBrace,
+    LeftBracket,
+    RightBracket,
     Comma,
     Dot,
     Plus,
@@ -21,6 +23,7 @@ enum class TokenType {
     Asterisk,
     Carret,
     Semicolon,
+    Colon,
     Percent,
 
     // One or Two Char
@@ -41,6 +44,7 @@ enum class TokenType {
     // Literals
     Identifier,
     String,
+    FormatString,
     Number,
     True,
     False,
@@ -59,6 +63,7 @@ enum class TokenType {
     Return,
     Func,
     Var,
+    Const,
     Exit,
     And,
     Or,
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // Tasks submitted together, waiting on a group only waits for its own tasks
+    struct Group {
+        std::atomic<int> pending{0};
+    };
+
+    ThreadPool(int count);
+    ~ThreadPool();
+
+    static ThreadPool& shared();
+
+    int size();
+    void submit(Group& group, std::function<void()> task);
+    void wait(Group& group);
+
+private:
+    struct Task {
+        std::function<void()> body;
+        Group* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(int index, Task& task);
+    bool steal(int index, Task& task);
+    void run(Task& task);
+    void work(int index);
+
+    bool stopping;
+    std::atomic<int> queued;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable finished;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+};
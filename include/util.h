@@ -15,3 +15,9 @@ typedef int32_t i32;
 typedef int64_t i64;
 
 std::string formatStr(const char* format, ...);
+
+// The shortest text that reads back as the same number, whole numbers skip the float formatting.
+// The buffer needs number_chars_max bytes and the length written is returned
+const int number_chars_max = 32;
+int formatNumber(double value, char* buffer);
+std::string numberStr(double value);
@@ -8,7 +8,8 @@ void builtIns::input(BuiltInHelper helper, int argc) {
     if (helper.assertArgc(argc, 1)) return;
     if (helper.assertArgType(0, Value::which<String>())) return;
 
-    std::cout << helper.arg(0).get<String>();
+    helper.interpreter->output.write(helper.arg(0).get<String>().view());
+    helper.interpreter->output.flush();
     std::string returnVal;
     std::getline(std::cin, returnVal);
     helper.setReturn(returnVal);
@@ -30,6 +31,128 @@ void builtIns::random(BuiltInHelper helper, int argc) {
     helper.setReturn((Number)distr(generator));
 }
 
+void builtIns::range(BuiltInHelper helper, int argc) {
+    if (argc < 1 || argc > 3) {
+        helper.error(formatStr("Expected 1 to 3 arguments, got %d", argc));
+        return;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        if (helper.assertArgType(i, Value::which<Number>())) return;
+    }
+
+    Shared<Range> range = std::make_shared<Range>();
+    range->start = argc == 1 ? 0 : helper.arg(0).get<Number>();
+    range->end = helper.arg(argc == 1 ? 0 : 1).get<Number>();
+    range->step = argc == 3 ? helper.arg(2).get<Number>() : 1;
+
+    if (range->step == 0) {
+        helper.error("Range step can't be zero");
+        return;
+    }
+
+    helper.setReturn(range);
+}
+
+void builtIns::len(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 1)) return;
+
+    Value value = helper.arg(0);
+    switch (value.which()) {
+        case Value::which<String>():
+            helper.setReturn((Number)value.get<String>().size());
+            return;
+        case Value::which<Shared<List>>():
+            helper.setReturn((Number)value.get<Shared<List>>()->size());
+            return;
+        case Value::which<Shared<Dict>>():
+            helper.setReturn((Number)value.get<Shared<Dict>>()->size());
+            return;
+        default:
+            helper.error(formatStr("Can't get the length of '%s'", getTypename(value.which())));
+            return;
+    }
+}
+
+void builtIns::push(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 2)) return;
+    if (helper.assertArgType(0, Value::which<Shared<List>>())) return;
+
+    helper.arg(0).get<Shared<List>>()->push(helper.arg(1));
+}
+
+void builtIns::pop(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 1)) return;
+    if (helper.assertArgType(0, Value::which<Shared<List>>())) return;
+
+    Shared<List> list = helper.arg(0).get<Shared<List>>();
+    if (!list->size()) {
+        helper.error("Can't pop from an empty list");
+        return;
+    }
+
+    helper.setReturn(list->pop());
+}
+
+void builtIns::insert(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 3)) return;
+    if (helper.assertArgType(0, Value::which<Shared<List>>())) return;
+
+    // Inserting at the length appends
+    Shared<List> list = helper.arg(0).get<Shared<List>>();
+    Value index = helper.arg(1);
+    size_t i;
+    if (!helper.interpreter->getIndex(index, list->size() + 1, i)) return;
+
+    list->insert(i, helper.arg(2));
+}
+
+void builtIns::extend(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 2)) return;
+    if (helper.assertArgType(0, Value::which<Shared<List>>())) return;
+    if (helper.assertArgType(1, Value::which<Shared<List>>())) return;
+
+    helper.arg(0).get<Shared<List>>()->extend(*helper.arg(1).get<Shared<List>>());
+}
+
+void builtIns::keys(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 1)) return;
+    if (helper.assertArgType(0, Value::which<Shared<Dict>>())) return;
+
+    Shared<Dict> dict = helper.arg(0).get<Shared<Dict>>();
+    Shared<List> list = std::make_shared<List>();
+    for (auto& entry : dict->entries) {
+        if (!entry.removed) {
+            list->push(entry.key);
+        }
+    }
+
+    helper.setReturn(list);
+}
+
+void builtIns::has(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 2)) return;
+    if (helper.assertArgType(0, Value::which<Shared<Dict>>())) return;
+
+    Value key = helper.arg(1);
+    size_t hash;
+    if (!helper.interpreter->hashKey(key, hash)) return;
+
+    helper.setReturn(helper.arg(0).get<Shared<Dict>>()->find(key, hash) != nullptr);
+}
+
+void builtIns::remove(BuiltInHelper helper, int argc) {
+    if (helper.assertArgc(argc, 2)) return;
+    if (helper.assertArgType(0, Value::which<Shared<Dict>>())) return;
+
+    // Gives back whether the key was there
+    Value key = helper.arg(1);
+    size_t hash;
+    if (!helper.interpreter->hashKey(key, hash)) return;
+
+    helper.setReturn(helper.arg(0).get<Shared<Dict>>()->remove(key, hash));
+}
+
 void BuiltInHelper::setReturn(Value value) {
     stack[0] = value;
 }
@@ -64,6 +187,15 @@ Shared<Module> initBuiltins() {
     std::vector<std::pair<std::string, BuiltInFunctionPtr>> pairs = {
         {"input", &builtIns::input},
         {"random", &builtIns::random},
+        {"range", &builtIns::range},
+        {"len", &builtIns::len},
+        {"push", &builtIns::push},
+        {"pop", &builtIns::pop},
+        {"insert", &builtIns::insert},
+        {"extend", &builtIns::extend},
+        {"keys", &builtIns::keys},
+        {"has", &builtIns::has},
+        {"remove", &builtIns::remove},
     };
 
     for (auto& [name, ptr] : pairs) {
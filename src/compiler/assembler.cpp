@@ -0,0 +1,244 @@
+#include "compiler/assembler.h"
+
+bool isJump(u8 instruction) {
+    switch (instruction) {
+        case OpJump:
+        case OpJumpBack:
+        case OpJumpIfTrue:
+        case OpJumpIfFalse:
+        case OpJumpPopIfFalse:
+        case OpForIter:
+        case OpForRange:
+        case OpForRangeLoop:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool jumpsBack(u8 instruction) {
+    return instruction == OpJumpBack || instruction == OpForRangeLoop;
+}
+
+bool isLoopJump(u8 instruction) {
+    switch (instruction) {
+        case OpForIter:
+        case OpForRange:
+        case OpForRangeLoop:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+int instructionLength(const Chunk& chunk, int offset) {
+    bool wide = chunk.bytecode[offset] == OpWide;
+    int prefix = wide;
+    int operand = wide ? 2 : 1;
+    u8 instruction = chunk.bytecode[offset + prefix];
+
+    switch (instruction) {
+        case OpExit:
+        case OpByteNumber:
+        case OpPrint:
+        case OpCall:
+        case OpList:
+        case OpDict:
+        case OpBuildString:
+        case OpInherit:
+            return prefix + 2;
+
+        case OpName:
+        case OpNumber:
+        case OpDefineGlobal:
+        case OpGetGlobal:
+        case OpSetGlobal:
+        case OpGetLocal:
+        case OpSetLocal:
+        case OpGetUpValue:
+        case OpSetUpValue:
+        case OpPopLocals:
+        case OpType:
+        case OpBindMethod:
+        case OpCheckFunction:
+            return prefix + 1 + operand;
+
+        case OpGetProperty:
+        case OpSetProperty:
+            return prefix + 1 + operand * 2;
+
+        case OpInvoke:
+            return prefix + 2 + operand * 2;
+
+        case OpJump:
+        case OpJumpBack:
+        case OpJumpIfTrue:
+        case OpJumpIfFalse:
+        case OpJumpPopIfFalse:
+            return prefix + (wide ? 5 : 3);
+
+        case OpForIter:
+        case OpForRange:
+        case OpForRangeLoop:
+            return prefix + (wide ? 7 : 5);
+
+        case OpFunction: {
+            int index = chunk.bytecode[offset + prefix + 1];
+            if (wide) {
+                index = index << 8 | chunk.bytecode[offset + prefix + 2];
+            }
+
+            return prefix + 1 + operand + chunk.prototypes[index]->upValues * (operand + 1);
+        }
+
+        default:
+            return prefix + 1;
+    }
+}
+
+static int readDistance(const Chunk& chunk, int offset, bool wide) {
+    auto& bytecode = chunk.bytecode;
+    if (wide) {
+        return bytecode[offset] << 24 | bytecode[offset + 1] << 16 | bytecode[offset + 2] << 8 | bytecode[offset + 3];
+    }
+
+    return bytecode[offset] << 8 | bytecode[offset + 1];
+}
+
+std::vector<AssembledInstruction> decodeChunk(const Chunk& chunk) {
+    auto& bytecode = chunk.bytecode;
+    int size = bytecode.size();
+
+    std::vector<AssembledInstruction> instructions;
+    std::vector<int> owner(size + 1);
+
+    for (int offset = 0; offset < size;) {
+        int length = instructionLength(chunk, offset);
+        bool wide = bytecode[offset] == OpWide;
+        u8 instruction = bytecode[offset + wide];
+        int target = -1;
+
+        if (isJump(instruction)) {
+            int after = offset + length;
+            int distance = readDistance(chunk, offset + wide + 1 + isLoopJump(instruction) * 2, wide);
+            target = jumpsBack(instruction) ? after - distance : after + distance;
+        }
+
+        for (int i = offset; i < offset + length && i < size; i++) {
+            owner[i] = instructions.size();
+        }
+
+        instructions.push_back(AssembledInstruction{instruction, offset, length, target, false});
+        offset += length;
+    }
+
+    owner[size] = instructions.size();
+    instructions.push_back(AssembledInstruction{OpExit, size, 0, -1, false});
+
+    for (auto& inst : instructions) {
+        if (inst.target != -1) {
+            inst.target = owner[inst.target];
+        }
+    }
+
+    return instructions;
+}
+
+void encodeChunk(Chunk& chunk, std::vector<AssembledInstruction>& instructions) {
+    auto& bytecode = chunk.bytecode;
+    int size = bytecode.size();
+
+    auto encodedLength = [](AssembledInstruction& inst) {
+        if (inst.target == -1 || inst.length == 0) {
+            return inst.length;
+        }
+
+        return (inst.wide ? 6 : 3) + isLoopJump(inst.instruction) * 2;
+    };
+
+    // Start with every jump short and only widen the ones that don't fit, widening can push others over
+    std::vector<int> starts(instructions.size());
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        int offset = 0;
+        for (int i = 0; i < (signed)instructions.size(); i++) {
+            starts[i] = offset;
+            offset += encodedLength(instructions[i]);
+        }
+
+        for (int i = 0; i < (signed)instructions.size(); i++) {
+            auto& inst = instructions[i];
+            if (inst.target == -1 || inst.length == 0 || inst.wide) continue;
+
+            int distance = std::abs(starts[inst.target] - (starts[i] + encodedLength(inst)));
+            if (distance > UINT16_MAX) {
+                inst.wide = true;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<u8> encoded;
+    encoded.reserve(size);
+
+    for (int i = 0; i < (signed)instructions.size(); i++) {
+        auto& inst = instructions[i];
+        if (inst.length == 0) continue;
+
+        if (inst.target == -1) {
+            if (inst.length == 1) {
+                encoded.push_back(inst.instruction);
+                continue;
+            }
+
+            int opcode = encoded.size() + (bytecode[inst.start] == OpWide);
+            encoded.insert(encoded.end(), bytecode.begin() + inst.start, bytecode.begin() + inst.start + inst.length);
+            encoded[opcode] = inst.instruction;
+            continue;
+        }
+
+        int after = starts[i] + encodedLength(inst);
+        int distance = std::abs(starts[inst.target] - after);
+
+        if (inst.wide) {
+            encoded.push_back(OpWide);
+        }
+        encoded.push_back(inst.instruction);
+
+        if (isLoopJump(inst.instruction)) {
+            int slot = inst.start + (bytecode[inst.start] == OpWide) + 1;
+            encoded.push_back(bytecode[slot]);
+            encoded.push_back(bytecode[slot + 1]);
+        }
+
+        if (inst.wide) {
+            encoded.push_back((u8)((distance >> 24) & 0xff));
+            encoded.push_back((u8)((distance >> 16) & 0xff));
+        }
+
+        encoded.push_back((u8)((distance >> 8) & 0xff));
+        encoded.push_back((u8)(distance & 0xff));
+    }
+
+    // Markers keep their place inside an instruction, the ones on removed instructions move to the next one
+    int index = 0;
+    for (auto& marker : chunk.markers) {
+        while (index + 1 < (signed)instructions.size() && instructions[index + 1].start <= marker.first) {
+            index++;
+        }
+
+        int length = encodedLength(instructions[index]);
+        int inside = std::max(std::min(marker.first - instructions[index].start, length - 1), 0);
+        marker.first = starts[index] + inside;
+    }
+
+    bytecode = std::move(encoded);
+}
+
+void relaxJumps(Chunk& chunk) {
+    std::vector<AssembledInstruction> instructions = decodeChunk(chunk);
+    encodeChunk(chunk, instructions);
+}
@@ -1,14 +1,98 @@
 #include "compiler/compiler.h"
 #include <cstring>
+#include "compiler/assembler.h"
+#include "compiler/folder.h"
+#include "compiler/ircompiler.h"
+#include "compiler/peephole.h"
+#include "syntax/parser.h"
+#include "threadpool.h"
+
+Chunk Compiler::compile(Shared<Ast> ast) {
+    hadError = false;
+    context = std::make_shared<CompileContext>();
+    context->options = options;
+    context->ast = ast;
+    context->resolution.constants = std::make_shared<ConstantPool>();
+
+    Folder(*ast, path).fold();
+
+    Resolver resolver = Resolver(path, options.lazy);
+    resolver.resolve(*ast, context->resolution);
+
+    if (resolver.failed()) {
+        hadError = true;
+        error = resolver.getError();
+        return Chunk{};
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    context->parallel = pool.size() && context->resolution.functionCount >= parallel_compile_threshold;
+
+    if (options.optimizeLevel > 1) {
+        collectInlineTargets(*ast);
+    }
 
-Chunk Compiler::compile(Ast& ast) {
     newChunk();
-    hadError = false;
+    chunkData->name = path;
     chunkData->global = true;
-    chunkData->localOffset = 0;
-    body(ast.body);
+    body(ast->body);
     emitByte(OpExit, 0);
-    return endChunk();
+    Chunk chunk = endChunk();
+
+    if (context->parallel) {
+        pool.wait(context->tasks);
+    }
+
+    collectErrors();
+    return chunk;
+}
+
+bool Compiler::compileLazy(Prototype& prot) {
+    Shared<LazyFunction> lazyFunction = prot.lazy;
+
+    hadError = false;
+    context = std::make_shared<CompileContext>();
+    context->parallel = false;
+    context->options = options;
+    context->options.lazy = false;
+    context->ast = lazyFunction->ast;
+    context->resolution.constants = prot.chunk.constants;
+    context->inlineTable = lazyFunction->inlineTable;
+
+    // Pre-parsed bodies were only bracket matched, so they still need to be parsed
+    FuncDeclaration& decl = *lazyFunction->decl;
+    if (decl.preparsed) {
+        Parser parser = Parser(lazyFunction->ast->source, path, decl.bodyView);
+        decl.body = parser.parseBody();
+
+        if (parser.failed()) {
+            hadError = true;
+            error = parser.getError();
+            return false;
+        }
+
+        decl.preparsed = false;
+        Folder(*lazyFunction->ast, path).foldFunction(decl);
+    }
+
+    Resolver resolver = Resolver(path);
+    resolver.resolveFunction(*lazyFunction->ast, decl, context->resolution);
+
+    if (resolver.failed()) {
+        hadError = true;
+        error = resolver.getError();
+        return false;
+    }
+
+    function(decl, prot);
+    collectErrors();
+
+    if (hadError) {
+        return false;
+    }
+
+    prot.lazy = nullptr;
+    return true;
 }
 
 bool Compiler::failed() {
@@ -24,55 +108,179 @@ Chunk* Compiler::getChunk() {
 }
 
 void Compiler::newChunk() {
-    std::unique_ptr<ChunkData> enclosing = std::move(chunkData);
     chunkData = std::make_unique<ChunkData>();
-    chunkData->enclosing = std::move(enclosing);
     chunkData->scopeDepth = 0;
+    chunkData->slots = 0;
     chunkData->global = false;
-    chunkData->localOffset = 1;
+    chunkData->initializer = false;
+    chunkData->chunk.constants = context->resolution.constants;
 }
 
 Chunk Compiler::endChunk() {
-    Chunk chunk = chunkData->chunk;
-    chunkData = std::move(chunkData->enclosing);
+    if (options.showStats) {
+        Chunk unoptimized = chunkData->chunk;
+        relaxJumps(unoptimized);
+        optimizeChunk(chunkData->chunk);
+
+        int before = unoptimized.bytecode.size();
+        int after = chunkData->chunk.bytecode.size();
+        printf("Chunk %s: %d -> %d bytes (saved %d)\n", chunkData->name.c_str(), before, after, before - after);
+    } else {
+        optimizeChunk(chunkData->chunk);
+    }
+
+    Chunk chunk = std::move(chunkData->chunk);
+    chunkData = nullptr;
     return chunk;
 }
 
+void Compiler::function(FuncDeclaration& stmt, Prototype& prot) {
+    // Bodies the ir can't express yet are compiled straight from the ast
+    if (options.optimizeLevel > 0 && IrCompiler(path, context).compileFunction(stmt, prot)) {
+        return;
+    }
+
+    hadError = false;
+    newChunk();
+    chunkData->name = stmt.name.name;
+    chunkData->initializer = stmt.method && stmt.name.name == "init";
+    beginScope();
+
+    for (auto& arg : stmt.args) {
+        addLocal(arg.name);
+    }
+
+    body(stmt.body);
+    endScope();
+
+    // Initializers always give back the new instance
+    if (chunkData->initializer) {
+        emitByte(OpGetLocal, (u8)0, OpReturn);
+    } else {
+        emitByte(OpNone, OpReturn);
+    }
+
+    prot.slots = chunkData->slots + 1;
+    prot.chunk = endChunk();
+
+    if (hadError) {
+        std::unique_lock<std::mutex> lock(context->mutex);
+        context->errors.push_back(error);
+    }
+}
+
+void Compiler::collectInlineTargets(Ast& ast) {
+    std::unordered_map<std::string, int> declarations;
+    for (Stmt& stmt : ast.body) {
+        if (stmt.is<Ptr<FuncDeclaration>>()) {
+            declarations[stmt.get<Ptr<FuncDeclaration>>()->name.name]++;
+        } else if (stmt.is<Ptr<VarDeclaration>>()) {
+            declarations[stmt.get<Ptr<VarDeclaration>>()->target.name] += 2;
+        } else if (stmt.is<Ptr<TypeDeclaration>>()) {
+            declarations[stmt.get<Ptr<TypeDeclaration>>()->name.name] += 2;
+        }
+    }
+
+    // Prototypes are made up front so a call can be inlined before its callee's declaration is compiled
+    context->inlineTable = std::make_shared<InlineTable>();
+    for (Stmt& stmt : ast.body) {
+        if (!stmt.is<Ptr<FuncDeclaration>>()) continue;
+
+        FuncDeclaration* decl = &*stmt.get<Ptr<FuncDeclaration>>();
+        if (declarations[decl->name.name] != 1) continue;
+
+        // Bodies compile in parallel after this, so lazy callees are parsed and resolved while nothing else runs
+        if (decl->preparsed) {
+            if (decl->bodyView.length > inline_source_max) continue;
+
+            Parser parser = Parser(ast.source, path, decl->bodyView);
+            std::vector<Stmt> body = parser.parseBody();
+            if (parser.failed()) continue;
+
+            decl->body = std::move(body);
+            decl->preparsed = false;
+            Folder(ast, path).foldFunction(*decl);
+        }
+
+        if (options.lazy) {
+            Resolver resolver = Resolver(path);
+            resolver.resolveFunction(ast, *decl, context->resolution);
+            if (resolver.failed()) continue;
+        }
+
+        Shared<Prototype> prot = std::make_shared<Prototype>();
+        context->prototypes[decl] = prot;
+        (*context->inlineTable)[decl->name.name] = InlineTarget{decl, prot};
+    }
+}
+
+void Compiler::collectErrors() {
+    // Function bodies finish in any order, report whichever error comes first in the source
+    for (auto& other : context->errors) {
+        if (!hadError || other.view.index < error.view.index) {
+            hadError = true;
+            error = other;
+        }
+    }
+}
+
 void Compiler::beginScope() {
     chunkData->scopeDepth++;
 }
 
 void Compiler::endScope() {
-    u8 localCount = 0;
-    for (auto& local : chunkData->locals) {
-        if (local.depth < chunkData->scopeDepth) {
+    int localCount = 0;
+    for (auto local = chunkData->locals.rbegin(); local != chunkData->locals.rend(); local++) {
+        if (local->depth < chunkData->scopeDepth) {
             break;
         }
 
         localCount++;
     }
 
-    emitByte(OpPopLocals, localCount);
+    emitInstruction(OpPopLocals, localCount);
 
     chunkData->scopeDepth--;
     chunkData->locals.resize(chunkData->locals.size() - localCount);
 }
 
-void Compiler::beginLoop() {
-    beginScope();
+void Compiler::beginLoop(int start) {
     std::unique_ptr<LoopData> enclosing = std::move(chunkData->loopData);
     chunkData->loopData = std::make_unique<LoopData>();
-    chunkData->loopData->start = (signed)getChunk()->bytecode.size();
+    chunkData->loopData->enclosing = std::move(enclosing);
+    chunkData->loopData->start = start;
+    chunkData->loopData->scopeDepth = chunkData->scopeDepth;
 }
 
 void Compiler::endLoop() {
-    endScope();
     for (int where : chunkData->loopData->breaks) {
         patchJump(where);
     }
     chunkData->loopData = std::move(chunkData->loopData->enclosing);
 }
 
+void Compiler::popLoopLocals() {
+    // Break and continue leave the body's scopes early, so their locals are dropped before jumping
+    int localCount = 0;
+    for (auto local = chunkData->locals.rbegin(); local != chunkData->locals.rend(); local++) {
+        if (local->depth <= chunkData->loopData->scopeDepth) {
+            break;
+        }
+
+        localCount++;
+    }
+
+    if (localCount) {
+        emitInstruction(OpPopLocals, localCount);
+    }
+}
+
+void Compiler::patchContinues() {
+    for (int where : chunkData->loopData->continues) {
+        patchJump(where);
+    }
+}
+
 void Compiler::errorAt(SourceView view, std::string msg, std::string note) {
     if (hadError) return;
     hadError = true;
@@ -88,18 +296,8 @@ void Compiler::internalError(std::string msg) {
 }
 
 int Compiler::makeNumberConstant(double value, SourceView view) {
-    auto& pool = getChunk()->constants.numbers;
-    auto it = std::find(pool.begin(), pool.end(), value);
-    int index;
-
-    if (it == pool.end()) {
-        pool.push_back(value);
-        index = pool.size() - 1;
-    } else {
-        index = std::distance(pool.begin(), it);
-    }
-
-    if (index > UINT8_MAX) {
+    int index = getChunk()->constants->addNumber(value);
+    if (index > UINT16_MAX) {
         errorAt(view, "Too many constants in pool");
     }
 
@@ -107,93 +305,26 @@ int Compiler::makeNumberConstant(double value, SourceView view) {
 }
 
 int Compiler::makeNameConstant(std::string value, SourceView view) {
-    auto& pool = getChunk()->constants.names;
-    auto it = std::find(pool.begin(), pool.end(), value);
-    int index;
-    if (it == pool.end()) {
-        pool.push_back(value);
-        index = (signed)pool.size() - 1;
-    } else {
-        index = std::distance(pool.begin(), it);
-    }
-
-    if (index > UINT8_MAX) {
+    int index = getChunk()->constants->addName(value);
+    if (index > UINT16_MAX) {
         errorAt(view, "Too many constants in pool");
     }
 
     return index;
 }
 
-void Compiler::addLocal(std::string name, SourceView view) {
-    for (auto& local : chunkData->locals) {
-        if (local.name == name && local.depth == chunkData->scopeDepth) {
-            errorAt(view, formatStr("Already a local called '%s'", name));
-            return;
-        }
-    }
-
-    if (chunkData->locals.size() > UINT8_MAX) {
-        errorAt(view, "Too many locals in scope");
-        return;
-    }
-
+void Compiler::addLocal(std::string name) {
     chunkData->locals.push_back(Local{name, chunkData->scopeDepth});
-}
-
-int Compiler::addUpValue(std::unique_ptr<ChunkData>& chunk, u8 index, bool isLocal, SourceView view) {
-    for (int i = 0; i < (signed)chunk->upValues.size(); i++) {
-        auto& upValue = chunk->upValues[i];
-        if (upValue.index == index && upValue.isLocal == isLocal) {
-            return i;
-        }
-    }
-
-    int count = chunk->upValues.size();
-    if (count > UINT8_MAX) {
-        errorAt(view, "Too many captured locals in scope");
-        return -1;
-    }
-
-    chunk->upValues.push_back(UpValueData{index, isLocal});
-    return count;
-}
-
-int Compiler::findLocal(std::unique_ptr<ChunkData>& chunk, std::string name) {
-    for (int index = 0; index < (signed)chunk->locals.size(); index++) {
-        if (chunk->locals[index].name == name) {
-            return index + chunk->localOffset;
-        }
-    }
-
-    return -1;
-}
-
-int Compiler::findUpValue(std::unique_ptr<ChunkData>& chunk, std::string name, SourceView view) {
-    if (chunk->enclosing == nullptr) {
-        return -1;
-    }
-
-    int local = findLocal(chunk->enclosing, name);
-    if (local != -1) {
-        return addUpValue(chunk, local, true, view);
-    }
-
-    int upValue = findUpValue(chunk->enclosing, name, view);
-    if (upValue != -1) {
-        return addUpValue(chunk, upValue, false, view);
-    }
-
-    return -1;
+    chunkData->slots = std::max(chunkData->slots, (int)chunkData->locals.size());
 }
 
 void Compiler::declare(std::string name, SourceView view) {
     if (chunkData->scopeDepth == 0) {
-        emitByte(OpDefineGlobal);
-        emitByte(makeNameConstant(name, view));
+        emitInstruction(OpDefineGlobal, makeNameConstant(name, view));
         return;
     }
 
-    addLocal(name, view);
+    addLocal(name);
 }
 
 void Compiler::body(std::vector<Stmt>& stmts) {
@@ -285,6 +416,7 @@ void Compiler::breakStmt(BreakStmt& stmt) {
         return;
     }
 
+    popLoopLocals();
     chunkData->loopData->breaks.push_back(emitJumpForwards(OpJump));
 }
 
@@ -294,7 +426,12 @@ void Compiler::continueStmt(ContinueStmt& stmt) {
         return;
     }
 
-    emitJumpBackwards(OpJumpBack, chunkData->loopData->start);
+    popLoopLocals();
+    if (chunkData->loopData->start == -1) {
+        chunkData->loopData->continues.push_back(emitJumpForwards(OpJump));
+    } else {
+        emitJumpBackwards(OpJumpBack, chunkData->loopData->start);
+    }
 }
 
 void Compiler::exitStmt(ExitStmt& stmt) {
@@ -305,14 +442,24 @@ void Compiler::exitStmt(ExitStmt& stmt) {
     emitByte(OpExit, (u8)stmt.code.value);
 }
 
-void Compiler::returnStmt(Ptr<ReturnStmt> stmt) {
+void Compiler::returnStmt(Ptr<ReturnStmt>& stmt) {
     if (chunkData->global) {
         errorAt(stmt->view, "Return outside function");
         return;
     }
 
+    if (chunkData->initializer) {
+        if (!stmt->value.is<NoneLiteral>()) {
+            errorAt(getSourceView(stmt->value), "Can't return a value from init");
+            return;
+        }
+
+        emitByte(OpGetLocal, (u8)0, OpReturn);
+        return;
+    }
+
     expression(stmt->value);
-    emitByte(OpSetLocal, 0, OpPop);
+    emitByte(OpReturn);
 }
 
 void Compiler::printStmt(Ptr<PrintStmt>& stmt) {
@@ -338,30 +485,103 @@ void Compiler::ifStmt(Ptr<IfStmt>& stmt) {
 }
 
 void Compiler::loopBlock(Ptr<LoopBlock>& stmt) {
-    beginLoop();
     int start = (signed)getChunk()->bytecode.size();
+    beginLoop(start);
+    beginScope();
     body(stmt->body);
+    endScope();
     emitJumpBackwards(OpJumpBack, start);
     endLoop();
 }
 
 void Compiler::whileLoop(Ptr<WhileLoop>& stmt) {
-    beginLoop();
     int start = (signed)getChunk()->bytecode.size();
+    beginLoop(start);
     expression(stmt->condition);
     int endJump = emitJumpForwards(OpJumpPopIfFalse);
+    beginScope();
     body(stmt->body);
+    endScope();
     emitJumpBackwards(OpJumpBack, start);
     patchJump(endJump);
     endLoop();
 }
 
 void Compiler::forLoop(Ptr<ForLoop>& stmt) {
-    internalError("For loops are not supported yet");
+    beginScope();
+
+    // The loop's state sits in the slots right below the target
+    int slot = context->resolution.variables.at(&stmt->target).index - (stmt->range ? 3 : 2);
+    if (stmt->range) {
+        rangeLoop(*stmt, slot);
+    } else {
+        iteratorLoop(*stmt, slot);
+    }
+
+    endScope();
+}
+
+void Compiler::rangeLoop(ForLoop& stmt, int slot) {
+    auto& args = stmt.iterator.get<Ptr<CallExpr>>()->args;
+    if (args.size() == 1) {
+        emitByte(OpByteNumber, (u8)0);
+        expression(args[0]);
+    } else {
+        expression(args[0]);
+        expression(args[1]);
+    }
+
+    if (args.size() == 3) {
+        expression(args[2]);
+    } else {
+        emitByte(OpByteNumber, (u8)1);
+    }
+
+    emitByte(OpNone);
+    addLocal(" counter");
+    addLocal(" end");
+    addLocal(" step");
+    addLocal(stmt.target.name);
+
+    // The first check also makes sure the bounds are numbers, stepping only has to add and compare
+    marker(stmt.iterator.get<Ptr<CallExpr>>()->view);
+    int exitJump = emitLoopJumpForwards(OpForRange, slot);
+    int start = (signed)getChunk()->bytecode.size();
+
+    beginLoop(-1);
+    beginScope();
+    body(stmt.body);
+    endScope();
+    patchContinues();
+    emitLoopJumpBackwards(OpForRangeLoop, start, slot);
+    patchJump(exitJump);
+    endLoop();
+}
+
+void Compiler::iteratorLoop(ForLoop& stmt, int slot) {
+    SourceView view = getSourceView(stmt.iterator);
+    expression(stmt.iterator);
+    marker(view);
+    emitByte(OpGetIter);
+    emitByte(OpNone);
+    addLocal(" iterable");
+    addLocal(" state");
+    addLocal(stmt.target.name);
+
+    int start = (signed)getChunk()->bytecode.size();
+    int exitJump = emitLoopJumpForwards(OpForIter, slot);
+
+    beginLoop(start);
+    beginScope();
+    body(stmt.body);
+    endScope();
+    emitJumpBackwards(OpJumpBack, start);
+    patchJump(exitJump);
+    endLoop();
 }
 
 void Compiler::typeDeclaration(Ptr<TypeDeclaration>& stmt) {
-    emitByte(OpType, makeNameConstant(stmt->name.name, stmt->name.view));
+    emitInstruction(OpType, makeNameConstant(stmt->name.name, stmt->name.view));
 
     if (stmt->parents.size() > UINT8_MAX) {
         SourceView view = stmt->parents[UINT8_MAX].view | stmt->parents.back().view;
@@ -377,44 +597,57 @@ void Compiler::typeDeclaration(Ptr<TypeDeclaration>& stmt) {
         emitByte(OpInherit, (u8)stmt->parents.size());
     }
 
-    // Add code for methods
+    for (auto& method : stmt->methods) {
+        FuncDeclaration& decl = *method.get<Ptr<FuncDeclaration>>();
+        Shared<Prototype> prot = emitPrototype(decl);
+        compileBody(decl, prot);
+        emitInstruction(OpBindMethod, makeNameConstant(decl.name.name, decl.name.view));
+    }
+
+    declare(stmt->name.name, stmt->name.view);
 }
 
 void Compiler::funcDeclaration(Ptr<FuncDeclaration>& stmt) {
-    emitByte(OpFunction, (signed)getChunk()->constants.prototypes.size());
-    newChunk();
-    beginScope();
-
-    chunkData->localOffset = 1;
+    Shared<Prototype> prot = emitPrototype(*stmt);
+    declare(stmt->name.name, stmt->name.view);
 
-    if (stmt->args.size() > UINT8_MAX) {
-        SourceView view = stmt->args[UINT8_MAX].view | stmt->args.back().view;
-        errorAt(view, formatStr("Too many arguments in function declaration (max: %d, you have %d)", UINT8_MAX, stmt->args.size()));
+    // Top level functions can't capture anything, so compiling them can wait until they are called
+    FuncDeclaration* decl = &*stmt;
+    if (options.lazy && chunkData->global && chunkData->scopeDepth == 0) {
+        prot->lazy = std::make_shared<LazyFunction>(LazyFunction{context->ast, decl, path, options, context->inlineTable});
+        prot->chunk.constants = getChunk()->constants;
         return;
     }
 
-    for (auto& arg : stmt->args) {
-        addLocal(arg.name, arg.view);
-    }
+    compileBody(*decl, prot);
+}
 
-    body(stmt->body);
-    endScope();
-    emitByte(OpReturn);
+Shared<Prototype> Compiler::emitPrototype(FuncDeclaration& stmt) {
+    std::vector<UpValueData>& upValues = context->resolution.upValues.at(&stmt);
 
-    for (auto& upValue : chunkData->upValues) {
-        chunkData->enclosing->chunk.bytecode.push_back(upValue.index);
-        chunkData->enclosing->chunk.bytecode.push_back((u8)upValue.isLocal);
-    }
+    auto made = context->prototypes.find(&stmt);
+    Shared<Prototype> prot = made != context->prototypes.end() ? made->second : std::make_shared<Prototype>();
+    prot->name = stmt.name.name;
+    prot->argc = stmt.args.size();
+    prot->upValues = upValues.size();
 
-    Prototype prot = {
-        stmt->name.name,
-        (u8)stmt->args.size(),
-        (u8)chunkData->upValues.size(),
-        endChunk(),
-    };
+    emitFunction(getChunk()->prototypes.size(), upValues);
+    getChunk()->prototypes.push_back(prot);
+    return prot;
+}
 
-    declare(stmt->name.name, stmt->name.view);
-    getChunk()->constants.prototypes.push_back(prot);
+void Compiler::compileBody(FuncDeclaration& stmt, Shared<Prototype> prot) {
+    // The body only depends on its own ast and the resolver's results, so it can be compiled anywhere
+    FuncDeclaration* decl = &stmt;
+    if (context->parallel) {
+        Shared<CompileContext> context = this->context;
+        std::string& path = this->path;
+        ThreadPool::shared().submit(context->tasks, [context, &path, decl, prot] {
+            Compiler(path, context).function(*decl, *prot);
+        });
+    } else {
+        Compiler(path, context).function(*decl, *prot);
+    }
 }
 
 void Compiler::varDeclaration(Ptr<VarDeclaration>& stmt) {
@@ -426,13 +659,12 @@ void Compiler::varDeclaration(Ptr<VarDeclaration>& stmt) {
     declare(stmt->target.name, stmt->target.view);
 }
 
-void Compiler::expression(Expr expr) {
+void Compiler::expression(Expr& expr) {
     switch (expr.which()) {
         case Expr::which<NumLiteral>(): {
             NumLiteral& num = expr.get<NumLiteral>();
-            if (num.value > UINT8_MAX || num.value < 0) {
-                int index = makeNumberConstant(num.value, num.view);
-                emitByte(OpNumber, (u8)index);
+            if (!fitsInByte(num.value)) {
+                emitInstruction(OpNumber, makeNumberConstant(num.value, num.view));
             } else {
                 emitByte(OpByteNumber, (u8)num.value);
             }
@@ -446,8 +678,7 @@ void Compiler::expression(Expr expr) {
 
         case Expr::which<StrLiteral>(): {
             StrLiteral& str = expr.get<StrLiteral>();
-            int index = makeNameConstant(str.value, str.view);
-            emitByte(OpName, (u8)index);
+            emitInstruction(OpName, makeNameConstant(str.value, str.view));
             break;
         }
 
@@ -489,6 +720,8 @@ void Compiler::expression(Expr expr) {
             expression(binaryExpr->left);
             expression(binaryExpr->right);
 
+            // The right operand may have marked its own operator, errors here belong to this one
+            marker(binaryExpr->opToken.view);
             switch (binaryExpr->op) {
                 case BinaryExpr::Operation::Add:
                     emitByte(OpAdd);
@@ -541,8 +774,7 @@ void Compiler::expression(Expr expr) {
 
             switch (unaryExpr->op) {
                 case UnaryExpr::Operation::Negative:
-                    makeNumberConstant(-1, unaryExpr->opToken.view);
-                    emitByte(OpMultiply);
+                    emitByte(OpNegate);
                     break;
                 case UnaryExpr::Operation::Negate:
                     emitByte(OpNot);
@@ -558,7 +790,13 @@ void Compiler::expression(Expr expr) {
             for (auto& expr : call->args) {
                 expression(expr);
             }
-            expression(call->target);
+
+            bool invoke = call->target.is<Ptr<PropertyExpr>>();
+            if (invoke) {
+                expression(call->target.get<Ptr<PropertyExpr>>()->expr);
+            } else {
+                expression(call->target);
+            }
 
             if (call->args.size() > UINT8_MAX) {
                 SourceView view = getSourceView(call->args[UINT8_MAX]);
@@ -569,8 +807,15 @@ void Compiler::expression(Expr expr) {
                 errorAt(view, formatStr("Too many arguments in function call (max: %d)", UINT8_MAX));
             }
 
-            marker(getSourceView(call->target));
-            emitByte(OpCall);
+            // Methods are looked up and called in one go, without binding them first
+            if (invoke) {
+                auto& prop = call->target.get<Ptr<PropertyExpr>>();
+                marker(prop->prop.view);
+                emitProperty(OpInvoke, makeNameConstant(prop->prop.name, prop->prop.view));
+            } else {
+                marker(getSourceView(call->target));
+                emitByte(OpCall);
+            }
             marker(call->view);
             emitByte(call->args.size());
             break;
@@ -580,7 +825,93 @@ void Compiler::expression(Expr expr) {
             auto& prop = expr.get<Ptr<PropertyExpr>>();
             expression(prop->expr);
             marker(prop->prop.view);
-            emitByte(OpGetProperty, makeNameConstant(prop->prop.name, prop->prop.view));
+            emitProperty(OpGetProperty, makeNameConstant(prop->prop.name, prop->prop.view));
+            break;
+        }
+
+        case Expr::which<Ptr<ListExpr>>(): {
+            auto& list = expr.get<Ptr<ListExpr>>();
+            for (auto& item : list->items) {
+                expression(item);
+            }
+
+            // Items sit on the stack until the list is made, so there can't be more than a call's arguments
+            if (list->items.size() > UINT8_MAX) {
+                SourceView view = getSourceView(list->items[UINT8_MAX]);
+                for (int i = UINT8_MAX + 1; i < (signed)list->items.size(); i++) {
+                    view = view | getSourceView(list->items[i]);
+                }
+
+                errorAt(view, formatStr("Too many items in list literal (max: %d)", UINT8_MAX));
+            }
+
+            emitByte(OpList);
+            emitByte(list->items.size());
+            break;
+        }
+
+        case Expr::which<Ptr<DictExpr>>(): {
+            auto& dict = expr.get<Ptr<DictExpr>>();
+            for (int i = 0; i < (signed)dict->keys.size(); i++) {
+                expression(dict->keys[i]);
+                expression(dict->values[i]);
+            }
+
+            if (dict->keys.size() > UINT8_MAX / 2) {
+                SourceView view = getSourceView(dict->keys[UINT8_MAX / 2]);
+                for (int i = UINT8_MAX / 2 + 1; i < (signed)dict->keys.size(); i++) {
+                    view = view | getSourceView(dict->values[i]);
+                }
+
+                errorAt(view, formatStr("Too many entries in dict literal (max: %d)", UINT8_MAX / 2));
+            }
+
+            marker(dict->view);
+            emitByte(OpDict);
+            emitByte(dict->keys.size());
+            break;
+        }
+
+        case Expr::which<Ptr<IndexExpr>>(): {
+            auto& index = expr.get<Ptr<IndexExpr>>();
+            expression(index->expr);
+            expression(index->index);
+            marker(index->view);
+            emitByte(OpGetIndex);
+            break;
+        }
+
+        case Expr::which<Ptr<FormatExpr>>(): {
+            auto& format = expr.get<Ptr<FormatExpr>>();
+            for (auto& part : format->parts) {
+                expression(part);
+            }
+
+            if (format->parts.size() > UINT8_MAX) {
+                errorAt(format->view, formatStr("Too many parts in format string (max: %d)", UINT8_MAX));
+            }
+
+            marker(format->view);
+            emitByte(OpBuildString);
+            emitByte(format->parts.size());
+            break;
+        }
+
+        case Expr::which<Ptr<SliceExpr>>(): {
+            auto& slice = expr.get<Ptr<SliceExpr>>();
+            expression(slice->expr);
+
+            // Left out bounds are None and default to the start or end at runtime
+            for (Expr* bound : {&slice->start, &slice->end}) {
+                if (bound->is<Empty>()) {
+                    emitByte(OpNone);
+                } else {
+                    expression(*bound);
+                }
+            }
+
+            marker(slice->view);
+            emitByte(OpSlice);
             break;
         }
 
@@ -603,7 +934,17 @@ void Compiler::assignment(Ptr<AssignmentExpr>& assignment) {
         case Expr::which<Ptr<PropertyExpr>>(): {
             auto& prop = assignment->target.get<Ptr<PropertyExpr>>();
             expression(prop->expr);
-            emitByte(OpSetProperty, makeNameConstant(prop->prop.name, prop->prop.view));
+            marker(prop->prop.view);
+            emitProperty(OpSetProperty, makeNameConstant(prop->prop.name, prop->prop.view));
+            break;
+        }
+
+        case Expr::which<Ptr<IndexExpr>>(): {
+            auto& index = assignment->target.get<Ptr<IndexExpr>>();
+            expression(index->expr);
+            expression(index->index);
+            marker(index->view);
+            emitByte(OpSetIndex);
             break;
         }
 
@@ -613,21 +954,24 @@ void Compiler::assignment(Ptr<AssignmentExpr>& assignment) {
 }
 
 void Compiler::identifier(Identifier& id, bool get) {
-    int local = findLocal(chunkData, id.name);
-    if (local != -1) {
-        emitByte(get ? OpGetLocal : OpSetLocal, local);
-        return;
-    }
+    Variable variable = context->resolution.variables.at(&id);
 
-    int upValue = findUpValue(chunkData, id.name, id.view);
-    if (upValue != -1) {
-        emitByte(get ? OpGetUpValue : OpSetUpValue, upValue);
-        return;
-    }
+    switch (variable.kind) {
+        case Variable::Local:
+            emitInstruction(get ? OpGetLocal : OpSetLocal, variable.index);
+            break;
 
-    marker(id.view);
-    emitByte(get ? OpGetGlobal : OpSetGlobal);
-    emitByte(makeNameConstant(id.name, id.view));
+        case Variable::UpValue:
+            emitInstruction(get ? OpGetUpValue : OpSetUpValue, variable.index);
+            break;
+
+        case Variable::Global: {
+            int index = makeNameConstant(id.name, id.view);
+            marker(id.view);
+            emitInstruction(get ? OpGetGlobal : OpSetGlobal, index);
+            break;
+        }
+    }
 }
 
 void Compiler::emitByte(u8 value) {
@@ -639,43 +983,102 @@ void Compiler::emitByte(u16 value) {
     emitByte((u8)(value & 0xff));
 }
 
-template <typename First>
-void Compiler::emitByte(First value) {
-    emitByte((u8)value);
+void Compiler::emitByte(u32 value) {
+    emitByte((u16)((value >> 16) & 0xffff));
+    emitByte((u16)(value & 0xffff));
 }
 
-template <typename First, typename... Rest>
-void Compiler::emitByte(First byte, Rest... rest) {
-    emitByte(byte);
-    emitByte(rest...);
+void Compiler::emitInstruction(u8 instruction, int operand) {
+    // Operands only take two bytes when they don't fit in one
+    bool wide = operand > UINT8_MAX;
+    if (wide) {
+        emitByte(OpWide);
+    }
+
+    emitByte(instruction);
+    emitOperand(operand, wide);
 }
 
-void Compiler::marker(SourceView & view) {
-    getChunk()->markers.push_back({getChunk()->bytecode.size(), view});
+void Compiler::emitOperand(int operand, bool wide) {
+    if (wide) {
+        emitByte((u16)operand);
+    } else {
+        emitByte((u8)operand);
+    }
 }
 
-void Compiler::emitJumpBackwards(u8 jump, int where) {
-    int distance = getChunk()->bytecode.size() - where + 2;
-    if (distance > UINT16_MAX) {
-        internalError("Condition jump too large");
+void Compiler::emitProperty(u8 instruction, int name) {
+    // Every property instruction gets its own inline cache
+    int cache = getChunk()->caches.size();
+    if (cache > UINT16_MAX) {
+        internalError("Too many property accesses in one function");
         return;
     }
 
-    emitByte(jump, (u16)distance);
+    getChunk()->caches.emplace_back();
+
+    bool wide = name > UINT8_MAX || cache > UINT8_MAX;
+    if (wide) {
+        emitByte(OpWide);
+    }
+
+    emitByte(instruction);
+    emitOperand(name, wide);
+    emitOperand(cache, wide);
+}
+
+void Compiler::emitFunction(int index, std::vector<UpValueData>& upValues) {
+    bool wide = index > UINT8_MAX;
+    for (auto& upValue : upValues) {
+        wide = wide || upValue.index > UINT8_MAX;
+    }
+
+    if (wide) {
+        emitByte(OpWide);
+    }
+
+    emitByte(OpFunction);
+    emitOperand(index, wide);
+    for (auto& upValue : upValues) {
+        emitOperand(upValue.index, wide);
+        emitByte((u8)upValue.isLocal);
+    }
+}
+
+void Compiler::marker(SourceView & view) {
+    getChunk()->markers.push_back({getChunk()->bytecode.size(), view});
+}
+
+void Compiler::emitJumpBackwards(u8 jump, int where) {
+    // Jumps always start out wide, relaxJumps shrinks them once the chunk is finished
+    emitByte(OpWide, jump);
+    emitByte((u32)(getChunk()->bytecode.size() + 4 - where));
 }
 
 int Compiler::emitJumpForwards(u8 jump) {
-    emitByte(jump, 0, 0);
-    return getChunk()->bytecode.size() - 2;
+    emitByte(OpWide, jump);
+    emitByte((u32)0);
+    return getChunk()->bytecode.size() - 4;
 }
 
-void Compiler::patchJump(int index) {
-    int distance = getChunk()->bytecode.size() - index - 2;
-    if (distance > UINT16_MAX) {
-        internalError("Condition jump too large");
-        return;
-    }
+// Loop jumps carry the slot of the loop's state before their distance
+void Compiler::emitLoopJumpBackwards(u8 jump, int where, int slot) {
+    emitByte(OpWide, jump);
+    emitByte((u16)slot);
+    emitByte((u32)(getChunk()->bytecode.size() + 4 - where));
+}
+
+int Compiler::emitLoopJumpForwards(u8 jump, int slot) {
+    emitByte(OpWide, jump);
+    emitByte((u16)slot);
+    emitByte((u32)0);
+    return getChunk()->bytecode.size() - 4;
+}
 
-    getChunk()->bytecode[index] = (u8)((distance >> 8) & 0xff);
-    getChunk()->bytecode[index + 1] = (u8)(distance & 0xff);
+void Compiler::patchJump(int index) {
+    int distance = getChunk()->bytecode.size() - index - 4;
+    getChunk()->bytecode[index] = (u8)((distance >> 24) & 0xff);
+    getChunk()->bytecode[index + 1] = (u8)((distance >> 16) & 0xff);
+    getChunk()->bytecode[index + 2] = (u8)((distance >> 8) & 0xff);
+    getChunk()->bytecode[index + 3] = (u8)(distance & 0xff);
 }
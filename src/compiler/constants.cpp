@@ -0,0 +1,36 @@
+#include "compiler/constants.h"
+#include <cstring>
+#include <mutex>
+
+template <typename T, typename Key>
+static int addConstant(std::shared_mutex& mutex, std::vector<T>& pool, std::unordered_map<Key, int>& indices, const Key& key, const T& value) {
+    // Function bodies compiled in parallel mostly find what the resolver already added
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = indices.find(key);
+        if (it != indices.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = indices.find(key);
+    if (it != indices.end()) {
+        return it->second;
+    }
+
+    pool.push_back(value);
+    indices[key] = pool.size() - 1;
+    return pool.size() - 1;
+}
+
+int ConstantPool::addNumber(double value) {
+    // Numbers are told apart by their bits, comparing them would merge -0 into 0
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return addConstant(mutex, numbers, numberIndices, bits, value);
+}
+
+int ConstantPool::addName(const std::string& value) {
+    return addConstant(mutex, names, nameIndices, value, value);
+}
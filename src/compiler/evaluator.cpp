@@ -0,0 +1,263 @@
+#include "compiler/evaluator.h"
+
+bool Evaluator::call(FuncDeclaration& func, std::vector<Expr>& args, Expr& result) {
+    if (args.size() != func.args.size() || depth >= evaluate_depth_max) {
+        return false;
+    }
+
+    // The callee can't see the caller's locals
+    std::vector<std::vector<std::pair<std::string, Expr>>> saved = std::move(scopes);
+    scopes.clear();
+    depth++;
+
+    beginScope();
+    for (int i = 0; i < (signed)args.size(); i++) {
+        scopes.back().emplace_back(func.args[i].name, args[i]);
+    }
+
+    Flow flow = body(func.body);
+
+    depth--;
+    scopes = std::move(saved);
+
+    switch (flow) {
+        case Flow::Next:
+            result = NoneLiteral{};
+            return true;
+        case Flow::Return:
+            result = std::move(returnValue);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void Evaluator::beginScope() {
+    scopes.emplace_back();
+}
+
+void Evaluator::endScope() {
+    scopes.pop_back();
+}
+
+Expr* Evaluator::lookup(std::string& name) {
+    for (int i = scopes.size() - 1; i >= 0; i--) {
+        auto& scope = scopes[i];
+        for (int j = scope.size() - 1; j >= 0; j--) {
+            if (scope[j].first == name) {
+                return &scope[j].second;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+Evaluator::Flow Evaluator::body(std::vector<Stmt>& stmts) {
+    for (Stmt& stmt : stmts) {
+        Flow flow = statement(stmt);
+        if (flow != Flow::Next) {
+            return flow;
+        }
+    }
+
+    return Flow::Next;
+}
+
+Evaluator::Flow Evaluator::statement(Stmt& stmt) {
+    if (++steps > evaluate_steps_max) {
+        return Flow::Fail;
+    }
+
+    switch (stmt.which()) {
+        case Stmt::which<BreakStmt>():
+            return Flow::Break;
+
+        case Stmt::which<ContinueStmt>():
+            return Flow::Continue;
+
+        case Stmt::which<Ptr<ExprStmt>>(): {
+            Expr result;
+            return expression(stmt.get<Ptr<ExprStmt>>()->expr, result) ? Flow::Next : Flow::Fail;
+        }
+
+        case Stmt::which<Ptr<ReturnStmt>>(): {
+            Expr& value = stmt.get<Ptr<ReturnStmt>>()->value;
+            if (value.is<Empty>()) {
+                returnValue = NoneLiteral{};
+                return Flow::Return;
+            }
+
+            return expression(value, returnValue) ? Flow::Return : Flow::Fail;
+        }
+
+        case Stmt::which<Ptr<IfStmt>>(): {
+            auto& ifStmt = stmt.get<Ptr<IfStmt>>();
+            Expr condition;
+            if (!expression(ifStmt->condition, condition)) {
+                return Flow::Fail;
+            }
+
+            return body(Folder::isTruthy(condition) ? ifStmt->body : ifStmt->orelse);
+        }
+
+        case Stmt::which<Ptr<LoopBlock>>():
+            return loop(nullptr, stmt.get<Ptr<LoopBlock>>()->body);
+
+        case Stmt::which<Ptr<WhileLoop>>(): {
+            auto& whileLoop = stmt.get<Ptr<WhileLoop>>();
+            return loop(&whileLoop->condition, whileLoop->body);
+        }
+
+        case Stmt::which<Ptr<VarDeclaration>>(): {
+            auto& var = stmt.get<Ptr<VarDeclaration>>();
+            Expr value = NoneLiteral{};
+            if (!var->expr.is<Empty>() && !expression(var->expr, value)) {
+                return Flow::Fail;
+            }
+
+            scopes.back().emplace_back(var->target.name, std::move(value));
+            return Flow::Next;
+        }
+
+        case Stmt::which<Ptr<BlockStmt>>(): {
+            beginScope();
+            Flow flow = body(stmt.get<Ptr<BlockStmt>>()->body);
+            endScope();
+            return flow;
+        }
+
+        default:
+            return Flow::Fail;
+    }
+}
+
+Evaluator::Flow Evaluator::loop(Expr* condition, std::vector<Stmt>& stmts) {
+    while (true) {
+        if (condition) {
+            Expr value;
+            if (!expression(*condition, value)) {
+                return Flow::Fail;
+            }
+
+            if (!Folder::isTruthy(value)) {
+                return Flow::Next;
+            }
+        }
+
+        beginScope();
+        Flow flow = body(stmts);
+        endScope();
+
+        switch (flow) {
+            case Flow::Break:
+                return Flow::Next;
+            case Flow::Return:
+            case Flow::Fail:
+                return flow;
+            default:
+                break;
+        }
+
+        if (++steps > evaluate_steps_max) {
+            return Flow::Fail;
+        }
+    }
+}
+
+bool Evaluator::expression(Expr& expr, Expr& result) {
+    if (++steps > evaluate_steps_max) {
+        return false;
+    }
+
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>():
+        case Expr::which<BoolLiteral>():
+        case Expr::which<StrLiteral>():
+        case Expr::which<NoneLiteral>():
+            result = expr;
+            return true;
+
+        case Expr::which<Identifier>(): {
+            Expr* value = lookup(expr.get<Identifier>().name);
+            if (!value) {
+                return false;
+            }
+
+            result = *value;
+            return true;
+        }
+
+        case Expr::which<Ptr<AssignmentExpr>>(): {
+            auto& assignment = expr.get<Ptr<AssignmentExpr>>();
+            if (!assignment->target.is<Identifier>() || !expression(assignment->expr, result)) {
+                return false;
+            }
+
+            Expr* value = lookup(assignment->target.get<Identifier>().name);
+            if (!value) {
+                return false;
+            }
+
+            *value = result;
+            return true;
+        }
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            auto& binary = expr.get<Ptr<BinaryExpr>>();
+            Expr left;
+            if (!expression(binary->left, left)) {
+                return false;
+            }
+
+            if (binary->op == BinaryExpr::Operation::And || binary->op == BinaryExpr::Operation::Or) {
+                bool truthy = Folder::isTruthy(left);
+                if (binary->op == BinaryExpr::Operation::And ? !truthy : truthy) {
+                    result = std::move(left);
+                    return true;
+                }
+
+                return expression(binary->right, result);
+            }
+
+            Expr right;
+            if (!expression(binary->right, right) || !Folder::foldBinary(binary->op, left, right, binary->view, result)) {
+                return false;
+            }
+
+            return !result.is<StrLiteral>() || result.get<StrLiteral>().value.size() <= evaluate_string_max;
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>(): {
+            auto& unary = expr.get<Ptr<UnaryExpr>>();
+            Expr operand;
+            return expression(unary->expr, operand) && Folder::foldUnary(unary->op, operand, unary->view, result);
+        }
+
+        case Expr::which<Ptr<CallExpr>>(): {
+            auto& callExpr = expr.get<Ptr<CallExpr>>();
+
+            // A local of the same name would be called instead of the global function
+            if (callExpr->target.is<Identifier>() && lookup(callExpr->target.get<Identifier>().name)) {
+                return false;
+            }
+
+            FuncDeclaration* func = folder.pureFunction(callExpr->target);
+            if (!func) {
+                return false;
+            }
+
+            std::vector<Expr> args(callExpr->args.size());
+            for (int i = 0; i < (signed)args.size(); i++) {
+                if (!expression(callExpr->args[i], args[i])) {
+                    return false;
+                }
+            }
+
+            return call(*func, args, result);
+        }
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,884 @@
+#include "compiler/folder.h"
+#include <algorithm>
+#include <cmath>
+#include "compiler/evaluator.h"
+#include "syntax/parser.h"
+
+void Folder::fold() {
+    // The table points into the top level, so it's made before folding starts moving statements around
+    findGlobals();
+    body(ast.body);
+}
+
+void Folder::foldFunction(FuncDeclaration& stmt) {
+    // A body is torn apart while it's folded, so nothing can be evaluated from it until it's done
+    folding.insert(&stmt);
+    body(stmt.body);
+    folding.erase(&stmt);
+}
+
+void Folder::body(std::vector<Stmt>& stmts) {
+    std::vector<Stmt> folded;
+    folded.reserve(stmts.size());
+
+    for (Stmt& stmt : stmts) {
+        if (statement(stmt, folded)) {
+            folded.push_back(std::move(stmt));
+        }
+    }
+
+    stmts = std::move(folded);
+}
+
+bool Folder::statement(Stmt& stmt, std::vector<Stmt>& out) {
+    switch (stmt.which()) {
+        case Stmt::which<Ptr<ExprStmt>>(): {
+            expression(stmt.get<Ptr<ExprStmt>>()->expr);
+            return true;
+        }
+
+        case Stmt::which<Ptr<ReturnStmt>>(): {
+            auto& returnStmt = stmt.get<Ptr<ReturnStmt>>();
+            if (!returnStmt->value.is<Empty>()) {
+                expression(returnStmt->value);
+            }
+            return true;
+        }
+
+        case Stmt::which<Ptr<PrintStmt>>(): {
+            for (auto& expr : stmt.get<Ptr<PrintStmt>>()->exprs) {
+                expression(expr);
+            }
+            return true;
+        }
+
+        case Stmt::which<Ptr<IfStmt>>(): {
+            auto& ifStmt = stmt.get<Ptr<IfStmt>>();
+            expression(ifStmt->condition);
+            body(ifStmt->body);
+            body(ifStmt->orelse);
+
+            if (!isConstant(ifStmt->condition)) {
+                return true;
+            }
+
+            // If bodies don't open a scope, so the branch that runs can replace the whole statement
+            std::vector<Stmt>& taken = isTruthy(ifStmt->condition) ? ifStmt->body : ifStmt->orelse;
+            for (Stmt& inner : taken) {
+                out.push_back(std::move(inner));
+            }
+            return false;
+        }
+
+        case Stmt::which<Ptr<LoopBlock>>(): {
+            body(stmt.get<Ptr<LoopBlock>>()->body);
+            return true;
+        }
+
+        case Stmt::which<Ptr<WhileLoop>>(): {
+            auto& whileLoop = stmt.get<Ptr<WhileLoop>>();
+            expression(whileLoop->condition);
+            body(whileLoop->body);
+
+            if (!isConstant(whileLoop->condition)) {
+                return true;
+            }
+
+            if (!isTruthy(whileLoop->condition)) {
+                return false;
+            }
+
+            // A condition that is always true doesn't need to be checked every iteration
+            SourceView view = whileLoop->view;
+            std::vector<Stmt> loopBody = std::move(whileLoop->body);
+            stmt = LoopBlock{view, std::move(loopBody)};
+            return true;
+        }
+
+        case Stmt::which<Ptr<ForLoop>>(): {
+            auto& forLoop = stmt.get<Ptr<ForLoop>>();
+            expression(forLoop->iterator);
+            body(forLoop->body);
+            forLoop->range = isRange(forLoop->iterator);
+            return true;
+        }
+
+        case Stmt::which<Ptr<TypeDeclaration>>(): {
+            body(stmt.get<Ptr<TypeDeclaration>>()->methods);
+            return true;
+        }
+
+        case Stmt::which<Ptr<FuncDeclaration>>(): {
+            foldFunction(*stmt.get<Ptr<FuncDeclaration>>());
+            return true;
+        }
+
+        case Stmt::which<Ptr<VarDeclaration>>(): {
+            auto& var = stmt.get<Ptr<VarDeclaration>>();
+            if (!var->expr.is<Empty>()) {
+                expression(var->expr);
+            }
+            globalConstant(*var);
+            return true;
+        }
+
+        case Stmt::which<Ptr<BlockStmt>>(): {
+            body(stmt.get<Ptr<BlockStmt>>()->body);
+            return true;
+        }
+
+        default:
+            return true;
+    }
+}
+
+void Folder::expression(Expr& expr) {
+    switch (expr.which()) {
+        case Expr::which<Ptr<AssignmentExpr>>(): {
+            auto& assignment = expr.get<Ptr<AssignmentExpr>>();
+            expression(assignment->expr);
+            if (assignment->target.is<Ptr<PropertyExpr>>()) {
+                expression(assignment->target.get<Ptr<PropertyExpr>>()->expr);
+            } else if (assignment->target.is<Ptr<IndexExpr>>()) {
+                auto& index = assignment->target.get<Ptr<IndexExpr>>();
+                expression(index->expr);
+                expression(index->index);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            binaryExpr(expr);
+            break;
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>(): {
+            unaryExpr(expr);
+            break;
+        }
+
+        case Expr::which<Ptr<CallExpr>>(): {
+            callExpr(expr);
+            break;
+        }
+
+        case Expr::which<Ptr<PropertyExpr>>(): {
+            expression(expr.get<Ptr<PropertyExpr>>()->expr);
+            break;
+        }
+
+        case Expr::which<Ptr<ListExpr>>(): {
+            for (auto& item : expr.get<Ptr<ListExpr>>()->items) {
+                expression(item);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<DictExpr>>(): {
+            auto& dict = expr.get<Ptr<DictExpr>>();
+            for (int i = 0; i < (signed)dict->keys.size(); i++) {
+                expression(dict->keys[i]);
+                expression(dict->values[i]);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<IndexExpr>>(): {
+            auto& index = expr.get<Ptr<IndexExpr>>();
+            expression(index->expr);
+            expression(index->index);
+            break;
+        }
+
+        case Expr::which<Ptr<SliceExpr>>(): {
+            auto& slice = expr.get<Ptr<SliceExpr>>();
+            expression(slice->expr);
+            expression(slice->start);
+            expression(slice->end);
+            break;
+        }
+
+        case Expr::which<Ptr<FormatExpr>>(): {
+            formatExpr(expr);
+            break;
+        }
+
+        case Expr::which<Identifier>(): {
+            identifier(expr);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void Folder::identifier(Expr& expr) {
+    Identifier& id = expr.get<Identifier>();
+    auto found = ast.constants.find(id.name);
+    if (found == ast.constants.end() || found->second.value.is<Empty>()) {
+        return;
+    }
+
+    // Reads from before the declaration could run before it has a value
+    if (found->second.decl->view.index > id.view.index) {
+        return;
+    }
+
+    SourceView view = id.view;
+    Expr& value = found->second.value;
+    switch (value.which()) {
+        case Expr::which<NumLiteral>():
+            expr = NumLiteral{view, value.get<NumLiteral>().value};
+            break;
+        case Expr::which<BoolLiteral>():
+            expr = BoolLiteral{view, value.get<BoolLiteral>().value};
+            break;
+        case Expr::which<StrLiteral>():
+            expr = StrLiteral{view, value.get<StrLiteral>().value};
+            break;
+        case Expr::which<Identifier>():
+            expr = Identifier{view, value.get<Identifier>().name};
+            break;
+        default:
+            expr = NoneLiteral{view};
+            break;
+    }
+}
+
+void Folder::globalConstant(VarDeclaration& var) {
+    auto found = ast.constants.find(var.target.name);
+    if (found == ast.constants.end() || found->second.decl != &var) {
+        return;
+    }
+
+    // Aliases of functions that can't be replaced either are known too, so calls through them can be inlined
+    Expr& expr = var.expr;
+    if (expr.is<Empty>()) {
+        found->second.value = NoneLiteral{};
+    } else if (isConstant(expr)) {
+        found->second.value = expr;
+    } else if (expr.is<Identifier>() && ast.functions.count(expr.get<Identifier>().name)) {
+        found->second.value = expr;
+    }
+}
+
+void Folder::binaryExpr(Expr& expr) {
+    auto& binary = expr.get<Ptr<BinaryExpr>>();
+    expression(binary->left);
+    expression(binary->right);
+
+    SourceView view = binary->view;
+
+    // Logical operators give back one of their operands, so only the left one has to be known
+    if (binary->op == BinaryExpr::Operation::And || binary->op == BinaryExpr::Operation::Or) {
+        if (!isConstant(binary->left)) {
+            return;
+        }
+
+        bool truthy = isTruthy(binary->left);
+        bool keepLeft = binary->op == BinaryExpr::Operation::And ? !truthy : truthy;
+        Expr result = std::move(keepLeft ? binary->left : binary->right);
+        expr = std::move(result);
+        return;
+    }
+
+    Expr result;
+    if (foldBinary(binary->op, binary->left, binary->right, view, result)) {
+        expr = std::move(result);
+    }
+}
+
+void Folder::unaryExpr(Expr& expr) {
+    auto& unary = expr.get<Ptr<UnaryExpr>>();
+    expression(unary->expr);
+
+    Expr result;
+    if (foldUnary(unary->op, unary->expr, unary->view, result)) {
+        expr = std::move(result);
+    }
+}
+
+void Folder::formatExpr(Expr& expr) {
+    auto& format = expr.get<Ptr<FormatExpr>>();
+    std::vector<Expr> parts;
+    for (auto& part : format->parts) {
+        expression(part);
+
+        // Neighbouring text is joined so the builder has fewer parts
+        if (part.is<StrLiteral>() && parts.size() && parts.back().is<StrLiteral>()) {
+            parts.back().get<StrLiteral>().value += part.get<StrLiteral>().value;
+        } else {
+            parts.push_back(std::move(part));
+        }
+    }
+
+    if (parts.size() == 1 && parts[0].is<StrLiteral>()) {
+        expr = StrLiteral{format->view, std::move(parts[0].get<StrLiteral>().value)};
+        return;
+    }
+
+    format->parts = std::move(parts);
+}
+
+void Folder::callExpr(Expr& expr) {
+    auto& call = expr.get<Ptr<CallExpr>>();
+    for (auto& arg : call->args) {
+        expression(arg);
+    }
+    expression(call->target);
+
+    if (!std::all_of(call->args.begin(), call->args.end(), isConstant)) {
+        return;
+    }
+
+    FuncDeclaration* func = pureFunction(call->target);
+    Expr result;
+    if (!func || !Evaluator(*this).call(*func, call->args, result)) {
+        return;
+    }
+
+    SourceView view = call->view;
+    switch (result.which()) {
+        case Expr::which<NumLiteral>():
+            expr = NumLiteral{view, result.get<NumLiteral>().value};
+            break;
+        case Expr::which<BoolLiteral>():
+            expr = BoolLiteral{view, result.get<BoolLiteral>().value};
+            break;
+        case Expr::which<StrLiteral>():
+            expr = StrLiteral{view, result.get<StrLiteral>().value};
+            break;
+        default:
+            expr = NoneLiteral{view};
+            break;
+    }
+}
+
+bool Folder::foldBinary(BinaryExpr::Operation op, Expr& left, Expr& right, SourceView view, Expr& result) {
+    if (!isConstant(left) || !isConstant(right)) {
+        return false;
+    }
+
+    if (op == BinaryExpr::Operation::Equal || op == BinaryExpr::Operation::NotEqual) {
+        bool equal = constantsEqual(left, right);
+        result = BoolLiteral{view, op == BinaryExpr::Operation::Equal ? equal : !equal};
+        return true;
+    }
+
+    if (left.is<StrLiteral>() && right.is<StrLiteral>()) {
+        if (op != BinaryExpr::Operation::Add) {
+            return false;
+        }
+
+        result = StrLiteral{view, left.get<StrLiteral>().value + right.get<StrLiteral>().value};
+        return true;
+    }
+
+    // Anything else that isn't two numbers is a runtime error, which is left for the interpreter to report
+    if (!left.is<NumLiteral>() || !right.is<NumLiteral>()) {
+        return false;
+    }
+
+    double a = left.get<NumLiteral>().value;
+    double b = right.get<NumLiteral>().value;
+
+    switch (op) {
+        case BinaryExpr::Operation::Add:
+            result = NumLiteral{view, a + b};
+            return true;
+        case BinaryExpr::Operation::Subtract:
+            result = NumLiteral{view, a - b};
+            return true;
+        case BinaryExpr::Operation::Modulous:
+            result = NumLiteral{view, std::fmod(a, b)};
+            return true;
+        case BinaryExpr::Operation::Multiply:
+            result = NumLiteral{view, a * b};
+            return true;
+        case BinaryExpr::Operation::Divide:
+            if (b == 0) {
+                return false;
+            }
+            result = NumLiteral{view, a / b};
+            return true;
+        case BinaryExpr::Operation::Exponent:
+            result = NumLiteral{view, std::pow(a, b)};
+            return true;
+        case BinaryExpr::Operation::GreaterThan:
+            result = BoolLiteral{view, a > b};
+            return true;
+        case BinaryExpr::Operation::LessThan:
+            result = BoolLiteral{view, a < b};
+            return true;
+        case BinaryExpr::Operation::GreaterThanOrEq:
+            result = BoolLiteral{view, a >= b};
+            return true;
+        case BinaryExpr::Operation::LessThanOrEq:
+            result = BoolLiteral{view, a <= b};
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Folder::foldUnary(UnaryExpr::Operation op, Expr& operand, SourceView view, Expr& result) {
+    switch (op) {
+        case UnaryExpr::Operation::Negative:
+            if (!operand.is<NumLiteral>()) {
+                return false;
+            }
+            result = NumLiteral{view, -operand.get<NumLiteral>().value};
+            return true;
+
+        default:
+            if (!isConstant(operand)) {
+                return false;
+            }
+            result = BoolLiteral{view, !isTruthy(operand)};
+            return true;
+    }
+}
+
+bool Folder::isConstant(Expr& expr) {
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>():
+        case Expr::which<BoolLiteral>():
+        case Expr::which<StrLiteral>():
+        case Expr::which<NoneLiteral>():
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Folder::isTruthy(Expr& expr) {
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>():
+            return expr.get<NumLiteral>().value != 0;
+        case Expr::which<BoolLiteral>():
+            return expr.get<BoolLiteral>().value;
+        case Expr::which<StrLiteral>():
+            return expr.get<StrLiteral>().value.size();
+        default:
+            return false;
+    }
+}
+
+// Mirrors Interpreter::valuesEqual
+bool Folder::constantsEqual(Expr& a, Expr& b) {
+    if (a.which() != b.which()) {
+        return false;
+    }
+
+    switch (a.which()) {
+        case Expr::which<NumLiteral>():
+            return a.get<NumLiteral>().value == b.get<NumLiteral>().value;
+        case Expr::which<StrLiteral>():
+            return a.get<StrLiteral>().value == b.get<StrLiteral>().value;
+        case Expr::which<BoolLiteral>():
+            return a.get<BoolLiteral>().value == b.get<BoolLiteral>().value;
+        case Expr::which<NoneLiteral>():
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Folder::isRange(Expr& iterator) {
+    if (!iterator.is<Ptr<CallExpr>>()) {
+        return false;
+    }
+
+    auto& call = iterator.get<Ptr<CallExpr>>();
+    if (!call->target.is<Identifier>() || call->target.get<Identifier>().name != "range") {
+        return false;
+    }
+
+    if (!ast.globalsFound) {
+        findGlobals();
+    }
+
+    // Anything bound to the name, even a local, could be what gets called instead of the builtin
+    return call->args.size() >= 1 && call->args.size() <= 3 && !ast.bindings.count("range");
+}
+
+FuncDeclaration* Folder::pureFunction(Expr& target) {
+    FuncDeclaration* func = callee(target);
+    if (!func || folding.count(func) || !isPure(*func)) {
+        return nullptr;
+    }
+
+    return func;
+}
+
+void Folder::findGlobals() {
+    ast.globalsFound = true;
+
+    // A name bound anywhere else could shadow the global or replace it, which can't be told apart
+    // without resolving every body, so every binding of a name is counted instead
+    findBindings(ast.body);
+
+    // Skipped bodies have no ast yet, any name used in one might be bound there
+    for (const std::string& name : ast.skippedNames) {
+        ast.bindings[name]++;
+    }
+
+    for (Stmt& stmt : ast.body) {
+        if (stmt.is<Ptr<FuncDeclaration>>()) {
+            FuncDeclaration* func = &*stmt.get<Ptr<FuncDeclaration>>();
+            if (ast.bindings[func->name.name] == 1) {
+                ast.functions[func->name.name] = func;
+            }
+        } else if (stmt.is<Ptr<VarDeclaration>>()) {
+            VarDeclaration* var = &*stmt.get<Ptr<VarDeclaration>>();
+            if (ast.bindings[var->target.name] == 1) {
+                ast.constants[var->target.name] = GlobalConstant{var, Empty{}};
+            }
+        }
+    }
+}
+
+void Folder::findBindings(std::vector<Stmt>& stmts) {
+    for (Stmt& stmt : stmts) {
+        findBindings(stmt);
+    }
+}
+
+void Folder::findBindings(Stmt& stmt) {
+    switch (stmt.which()) {
+        case Stmt::which<Ptr<ExprStmt>>():
+            findBindings(stmt.get<Ptr<ExprStmt>>()->expr);
+            break;
+
+        case Stmt::which<Ptr<PrintStmt>>():
+            for (Expr& expr : stmt.get<Ptr<PrintStmt>>()->exprs) {
+                findBindings(expr);
+            }
+            break;
+
+        case Stmt::which<Ptr<IfStmt>>(): {
+            auto& ifStmt = stmt.get<Ptr<IfStmt>>();
+            findBindings(ifStmt->condition);
+            findBindings(ifStmt->body);
+            findBindings(ifStmt->orelse);
+            break;
+        }
+
+        case Stmt::which<Ptr<LoopBlock>>():
+            findBindings(stmt.get<Ptr<LoopBlock>>()->body);
+            break;
+
+        case Stmt::which<Ptr<WhileLoop>>(): {
+            auto& loop = stmt.get<Ptr<WhileLoop>>();
+            findBindings(loop->condition);
+            findBindings(loop->body);
+            break;
+        }
+
+        case Stmt::which<Ptr<ForLoop>>(): {
+            auto& loop = stmt.get<Ptr<ForLoop>>();
+            ast.bindings[loop->target.name]++;
+            findBindings(loop->iterator);
+            findBindings(loop->body);
+            break;
+        }
+
+        case Stmt::which<Ptr<ReturnStmt>>():
+            findBindings(stmt.get<Ptr<ReturnStmt>>()->value);
+            break;
+
+        // Methods are only reached through an instance, their names don't bind anything
+        case Stmt::which<Ptr<FuncDeclaration>>(): {
+            auto& func = stmt.get<Ptr<FuncDeclaration>>();
+            if (!func->method) {
+                ast.bindings[func->name.name]++;
+            }
+
+            for (Identifier& arg : func->args) {
+                ast.bindings[arg.name]++;
+            }
+
+            findBindings(func->body);
+            break;
+        }
+
+        case Stmt::which<Ptr<VarDeclaration>>(): {
+            auto& var = stmt.get<Ptr<VarDeclaration>>();
+            ast.bindings[var->target.name]++;
+            findBindings(var->expr);
+            break;
+        }
+
+        case Stmt::which<Ptr<BlockStmt>>():
+            findBindings(stmt.get<Ptr<BlockStmt>>()->body);
+            break;
+
+        case Stmt::which<Ptr<TypeDeclaration>>(): {
+            auto& type = stmt.get<Ptr<TypeDeclaration>>();
+            ast.bindings[type->name.name]++;
+            findBindings(type->methods);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void Folder::findBindings(Expr& expr) {
+    switch (expr.which()) {
+        case Expr::which<Ptr<AssignmentExpr>>(): {
+            auto& assignment = expr.get<Ptr<AssignmentExpr>>();
+            if (assignment->target.is<Identifier>()) {
+                ast.bindings[assignment->target.get<Identifier>().name]++;
+            } else {
+                findBindings(assignment->target);
+            }
+            findBindings(assignment->expr);
+            break;
+        }
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            auto& binaryExpr = expr.get<Ptr<BinaryExpr>>();
+            findBindings(binaryExpr->left);
+            findBindings(binaryExpr->right);
+            break;
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>():
+            findBindings(expr.get<Ptr<UnaryExpr>>()->expr);
+            break;
+
+        case Expr::which<Ptr<CallExpr>>(): {
+            auto& call = expr.get<Ptr<CallExpr>>();
+            findBindings(call->target);
+            for (Expr& arg : call->args) {
+                findBindings(arg);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<PropertyExpr>>():
+            findBindings(expr.get<Ptr<PropertyExpr>>()->expr);
+            break;
+
+        case Expr::which<Ptr<ListExpr>>():
+            for (Expr& item : expr.get<Ptr<ListExpr>>()->items) {
+                findBindings(item);
+            }
+            break;
+
+        case Expr::which<Ptr<DictExpr>>(): {
+            auto& dict = expr.get<Ptr<DictExpr>>();
+            for (Expr& key : dict->keys) {
+                findBindings(key);
+            }
+            for (Expr& value : dict->values) {
+                findBindings(value);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<IndexExpr>>(): {
+            auto& index = expr.get<Ptr<IndexExpr>>();
+            findBindings(index->expr);
+            findBindings(index->index);
+            break;
+        }
+
+        case Expr::which<Ptr<SliceExpr>>(): {
+            auto& slice = expr.get<Ptr<SliceExpr>>();
+            findBindings(slice->expr);
+            findBindings(slice->start);
+            findBindings(slice->end);
+            break;
+        }
+
+        case Expr::which<Ptr<FormatExpr>>():
+            for (Expr& part : expr.get<Ptr<FormatExpr>>()->parts) {
+                findBindings(part);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+FuncDeclaration* Folder::callee(Expr& target) {
+    if (!target.is<Identifier>()) {
+        return nullptr;
+    }
+
+    if (!ast.globalsFound) {
+        findGlobals();
+    }
+
+    // Calls from before the declaration could run before the function exists
+    Identifier& name = target.get<Identifier>();
+    auto found = ast.functions.find(name.name);
+    if (found == ast.functions.end() || found->second->view.index > name.view.index) {
+        return nullptr;
+    }
+
+    // Lazily compiled bodies are parsed early when something wants to run them
+    FuncDeclaration& func = *found->second;
+    if (func.preparsed) {
+        if (func.bodyView.length > evaluate_source_max) {
+            return nullptr;
+        }
+
+        Parser parser = Parser(ast.source, path, func.bodyView);
+        std::vector<Stmt> parsed = parser.parseBody();
+        if (parser.failed()) {
+            return nullptr;
+        }
+
+        func.body = std::move(parsed);
+        func.preparsed = false;
+        foldFunction(func);
+    }
+
+    return &func;
+}
+
+bool Folder::isPure(FuncDeclaration& stmt) {
+    auto known = purity.find(&stmt);
+    if (known != purity.end()) {
+        return known->second;
+    }
+
+    // Recursive calls are assumed pure, the outermost check decides for the whole cycle
+    if (visiting.count(&stmt)) {
+        return true;
+    }
+
+    // Bodies haven't been resolved yet, anything the resolver would reject is left for it to report
+    // Locals map to whether they can be assigned to
+    std::unordered_map<std::string, bool> locals;
+    for (auto& arg : stmt.args) {
+        if (!locals.emplace(arg.name, true).second) {
+            purity[&stmt] = false;
+            return false;
+        }
+    }
+
+    visiting.insert(&stmt);
+    bool pure = isPure(stmt.body, locals);
+    visiting.erase(&stmt);
+
+    if (!pure || visiting.empty()) {
+        purity[&stmt] = pure;
+    }
+
+    return pure;
+}
+
+bool Folder::isPure(std::vector<Stmt>& stmts, std::unordered_map<std::string, bool>& locals) {
+    for (Stmt& stmt : stmts) {
+        bool pure;
+
+        switch (stmt.which()) {
+            case Stmt::which<BreakStmt>():
+            case Stmt::which<ContinueStmt>():
+                pure = true;
+                break;
+
+            case Stmt::which<Ptr<ExprStmt>>():
+                pure = isPure(stmt.get<Ptr<ExprStmt>>()->expr, locals);
+                break;
+
+            case Stmt::which<Ptr<ReturnStmt>>(): {
+                Expr& value = stmt.get<Ptr<ReturnStmt>>()->value;
+                pure = value.is<Empty>() || isPure(value, locals);
+                break;
+            }
+
+            case Stmt::which<Ptr<IfStmt>>(): {
+                auto& ifStmt = stmt.get<Ptr<IfStmt>>();
+                pure = isPure(ifStmt->condition, locals) && isPure(ifStmt->body, locals) && isPure(ifStmt->orelse, locals);
+                break;
+            }
+
+            case Stmt::which<Ptr<LoopBlock>>():
+                pure = isPure(stmt.get<Ptr<LoopBlock>>()->body, locals);
+                break;
+
+            case Stmt::which<Ptr<WhileLoop>>(): {
+                auto& whileLoop = stmt.get<Ptr<WhileLoop>>();
+                pure = isPure(whileLoop->condition, locals) && isPure(whileLoop->body, locals);
+                break;
+            }
+
+            case Stmt::which<Ptr<VarDeclaration>>(): {
+                auto& var = stmt.get<Ptr<VarDeclaration>>();
+                pure = (var->expr.is<Empty>() || isPure(var->expr, locals)) && locals.emplace(var->target.name, !var->constant).second;
+                break;
+            }
+
+            case Stmt::which<Ptr<BlockStmt>>():
+                pure = isPure(stmt.get<Ptr<BlockStmt>>()->body, locals);
+                break;
+
+            // Printing, exiting and declaring anything global all have effects outside the call
+            default:
+                pure = false;
+                break;
+        }
+
+        if (!pure) return false;
+    }
+
+    return true;
+}
+
+bool Folder::isPure(Expr& expr, std::unordered_map<std::string, bool>& locals) {
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>():
+        case Expr::which<BoolLiteral>():
+        case Expr::which<StrLiteral>():
+        case Expr::which<NoneLiteral>():
+            return true;
+
+        // Globals can change between calls, so only locals can be read
+        case Expr::which<Identifier>():
+            return locals.count(expr.get<Identifier>().name);
+
+        case Expr::which<Ptr<AssignmentExpr>>(): {
+            auto& assignment = expr.get<Ptr<AssignmentExpr>>();
+            Expr& target = assignment->target;
+            if (!target.is<Identifier>()) {
+                return false;
+            }
+
+            auto local = locals.find(target.get<Identifier>().name);
+            return local != locals.end() && local->second && isPure(assignment->expr, locals);
+        }
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            auto& binaryExpr = expr.get<Ptr<BinaryExpr>>();
+            return isPure(binaryExpr->left, locals) && isPure(binaryExpr->right, locals);
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>():
+            return isPure(expr.get<Ptr<UnaryExpr>>()->expr, locals);
+
+        case Expr::which<Ptr<CallExpr>>(): {
+            auto& call = expr.get<Ptr<CallExpr>>();
+            for (auto& arg : call->args) {
+                if (!isPure(arg, locals)) return false;
+            }
+
+            if (call->target.is<Identifier>() && locals.count(call->target.get<Identifier>().name)) {
+                return false;
+            }
+
+            FuncDeclaration* func = callee(call->target);
+            return func && !folding.count(func) && isPure(*func);
+        }
+
+        default:
+            return false;
+    }
+}
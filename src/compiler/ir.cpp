@@ -0,0 +1,1025 @@
+#include "compiler/ir.h"
+#include <algorithm>
+
+bool isConstant(IrOp op) {
+    switch (op) {
+        case IrNumber:
+        case IrString:
+        case IrTrue:
+        case IrFalse:
+        case IrNone:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool isTerminator(IrOp op) {
+    switch (op) {
+        case IrJump:
+        case IrBranch:
+        case IrReturn:
+        case IrExit:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool producesValue(IrOp op) {
+    return op != IrPrint && !isTerminator(op);
+}
+
+bool hasSideEffects(IrOp op) {
+    switch (op) {
+        case IrSetGlobal:
+        case IrSetUpValue:
+        case IrSetProperty:
+        case IrCall:
+        case IrInvoke:
+        case IrPrint:
+            return true;
+
+        default:
+            return isTerminator(op);
+    }
+}
+
+int terminator(IrFunction& func, int block) {
+    auto& instructions = func.blocks[block].instructions;
+    if (instructions.size() && isTerminator(func.instructions[instructions.back()].op)) {
+        return instructions.back();
+    }
+
+    return -1;
+}
+
+std::vector<int> countUses(IrFunction& func) {
+    std::vector<int> uses(func.instructions.size());
+    for (auto& inst : func.instructions) {
+        if (inst.removed) continue;
+
+        for (int arg : inst.args) {
+            uses[arg]++;
+        }
+    }
+
+    return uses;
+}
+
+int resolveReplacement(std::vector<int>& replacements, int value) {
+    while (replacements[value] != -1) {
+        value = replacements[value];
+    }
+
+    return value;
+}
+
+void replaceUses(IrFunction& func, std::vector<int>& replacements) {
+    for (auto& inst : func.instructions) {
+        if (inst.removed) continue;
+
+        for (int& arg : inst.args) {
+            arg = resolveReplacement(replacements, arg);
+        }
+    }
+}
+
+void removeMarked(IrFunction& func) {
+    for (auto& block : func.blocks) {
+        auto& instructions = block.instructions;
+        instructions.erase(std::remove_if(instructions.begin(), instructions.end(), [&](int index) {
+            return func.instructions[index].removed;
+        }), instructions.end());
+    }
+
+    for (auto& inst : func.instructions) {
+        if (inst.removed) {
+            inst.args.clear();
+        }
+    }
+}
+
+std::vector<int> reversePostorder(IrFunction& func) {
+    std::vector<int> order;
+    std::vector<bool> visited(func.blocks.size());
+    std::vector<std::pair<int, int>> stack = {{0, 0}};
+    visited[0] = true;
+
+    // Successors are visited last to first so a block's first successor ends up right after it
+    while (stack.size()) {
+        auto& [block, next] = stack.back();
+        auto& succs = func.blocks[block].succs;
+
+        if (next < (signed)succs.size()) {
+            int succ = succs[succs.size() - 1 - next++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack.push_back({succ, 0});
+            }
+            continue;
+        }
+
+        order.push_back(block);
+        stack.pop_back();
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<int> immediateDominators(IrFunction& func) {
+    std::vector<int> order = reversePostorder(func);
+    std::vector<int> number(func.blocks.size(), -1);
+    for (int i = 0; i < (signed)order.size(); i++) {
+        number[order[i]] = i;
+    }
+
+    std::vector<int> idoms(func.blocks.size(), -1);
+    idoms[0] = 0;
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = 1; i < (signed)order.size(); i++) {
+            int block = order[i];
+            int idom = -1;
+
+            for (int pred : func.blocks[block].preds) {
+                if (idoms[pred] == -1) continue;
+
+                if (idom == -1) {
+                    idom = pred;
+                    continue;
+                }
+
+                int a = pred, b = idom;
+                while (a != b) {
+                    while (number[a] > number[b]) a = idoms[a];
+                    while (number[b] > number[a]) b = idoms[b];
+                }
+                idom = a;
+            }
+
+            if (idoms[block] != idom) {
+                idoms[block] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    return idoms;
+}
+
+bool dominates(std::vector<int>& idoms, int a, int b) {
+    while (b != a && b != 0 && b != -1) {
+        b = idoms[b];
+    }
+
+    return b == a;
+}
+
+std::vector<bool> inferNumbers(IrFunction& func) {
+    // Starts optimistic and only ever turns values off, so loops settle on the largest consistent answer
+    std::vector<bool> numbers(func.instructions.size(), true);
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = 0; i < (signed)func.instructions.size(); i++) {
+            auto& inst = func.instructions[i];
+            if (inst.removed || !numbers[i]) continue;
+
+            bool number;
+            switch (inst.op) {
+                case IrNumber:
+                case IrSubtract:
+                case IrModulous:
+                case IrMultiply:
+                case IrDivide:
+                case IrExponent:
+                case IrNegate:
+                    number = true;
+                    break;
+
+                case IrAdd:
+                    number = numbers[inst.args[0]] && numbers[inst.args[1]];
+                    break;
+
+                case IrPhi:
+                    number = std::all_of(inst.args.begin(), inst.args.end(), [&](int arg) { return numbers[arg]; });
+                    break;
+
+                default:
+                    number = false;
+                    break;
+            }
+
+            if (!number) {
+                numbers[i] = false;
+                changed = true;
+            }
+        }
+    }
+
+    return numbers;
+}
+
+bool canTrap(IrFunction& func, std::vector<bool>& numbers, int index) {
+    auto& inst = func.instructions[index];
+    auto bothNumbers = [&]() {
+        return numbers[inst.args[0]] && numbers[inst.args[1]];
+    };
+
+    switch (inst.op) {
+        case IrParam:
+        case IrNumber:
+        case IrString:
+        case IrTrue:
+        case IrFalse:
+        case IrNone:
+        case IrPhi:
+        case IrEqual:
+        case IrNotEqual:
+        case IrNot:
+        case IrGetUpValue:
+        case IrCheckFunction:
+            return false;
+
+        case IrAdd:
+        case IrSubtract:
+        case IrModulous:
+        case IrMultiply:
+        case IrExponent:
+        case IrGreater:
+        case IrLess:
+        case IrGreaterThanOrEq:
+        case IrLessThanOrEq:
+            return !bothNumbers();
+
+        case IrDivide: {
+            auto& divisor = func.instructions[inst.args[1]];
+            return !bothNumbers() || divisor.op != IrNumber || divisor.number == 0;
+        }
+
+        case IrNegate:
+            return !numbers[inst.args[0]];
+
+        default:
+            return true;
+    }
+}
+
+void removeUnreachableBlocks(IrFunction& func) {
+    std::vector<bool> reachable(func.blocks.size());
+    for (int block : reversePostorder(func)) {
+        reachable[block] = true;
+    }
+
+    for (int block = 0; block < (signed)func.blocks.size(); block++) {
+        if (reachable[block] || func.blocks[block].removed) continue;
+
+        // Phis lose the operand that came from the removed edge
+        for (int succ : func.blocks[block].succs) {
+            auto& preds = func.blocks[succ].preds;
+            auto pred = std::find(preds.begin(), preds.end(), block);
+            int index = pred - preds.begin();
+            preds.erase(pred);
+
+            for (int inst : func.blocks[succ].instructions) {
+                if (func.instructions[inst].op == IrPhi) {
+                    auto& args = func.instructions[inst].args;
+                    args.erase(args.begin() + index);
+                }
+            }
+        }
+
+        for (int inst : func.blocks[block].instructions) {
+            func.instructions[inst].removed = true;
+            func.instructions[inst].args.clear();
+        }
+
+        func.blocks[block] = IrBlock{{}, {}, {}, true};
+    }
+}
+
+void splitCriticalEdges(IrFunction& func) {
+    // Phi copies go at the end of a predecessor, which only works when it has a single successor
+    int count = func.blocks.size();
+    for (int block = 0; block < count; block++) {
+        if (func.blocks[block].succs.size() < 2) continue;
+
+        for (int& succ : func.blocks[block].succs) {
+            auto& target = func.blocks[succ];
+            bool hasPhis = target.instructions.size() && func.instructions[target.instructions.front()].op == IrPhi;
+            if (!hasPhis) continue;
+
+            int split = func.blocks.size();
+            std::replace(target.preds.begin(), target.preds.end(), block, split);
+
+            func.instructions.push_back(IrInstruction{IrJump, split, 0, 0, {}, {}, false});
+            func.blocks.push_back(IrBlock{{(int)func.instructions.size() - 1}, {block}, {succ}, false});
+            succ = split;
+        }
+    }
+}
+
+bool IrBuilder::build(FuncDeclaration& stmt, IrFunction& func) {
+    this->func = &func;
+    failed = false;
+    scopeDepth = 0;
+    slotBase = 0;
+    inlineCount = 0;
+    returnBlock = -1;
+    function = &stmt;
+
+    func.name = stmt.name.name;
+    func.argc = stmt.args.size();
+    current = newBlock();
+    sealBlock(current);
+
+    beginScope();
+    for (auto& arg : stmt.args) {
+        int slot = declare(arg.name);
+        writeVariable(slot, current, emit(IrParam, {}, slot));
+    }
+
+    body(stmt.body);
+
+    if (!isTerminated()) {
+        emit(IrReturn, {emit(IrNone)});
+    }
+
+    endScope();
+    removeUnreachableBlocks(func);
+    return !failed;
+}
+
+int IrBuilder::newBlock() {
+    func->blocks.push_back(IrBlock{{}, {}, {}, false});
+    sealed.push_back(false);
+    definitions.emplace_back();
+    incompletePhis.emplace_back();
+    return func->blocks.size() - 1;
+}
+
+void IrBuilder::sealBlock(int block) {
+    for (auto& [slot, phi] : incompletePhis[block]) {
+        addPhiOperands(slot, phi);
+    }
+
+    incompletePhis[block].clear();
+    sealed[block] = true;
+}
+
+bool IrBuilder::isTerminated() {
+    return terminator(*func, current) != -1;
+}
+
+void IrBuilder::jump(int target) {
+    emit(IrJump);
+    func->blocks[current].succs.push_back(target);
+    func->blocks[target].preds.push_back(current);
+}
+
+void IrBuilder::branch(int condition, int ifTrue, int ifFalse) {
+    emit(IrBranch, {condition});
+    for (int target : {ifTrue, ifFalse}) {
+        func->blocks[current].succs.push_back(target);
+        func->blocks[target].preds.push_back(current);
+    }
+}
+
+void IrBuilder::unreachable() {
+    // Whatever follows a jump still needs a block, it's removed once the function is built
+    current = newBlock();
+    sealBlock(current);
+}
+
+int IrBuilder::emit(IrOp op, std::vector<int> args, int operand, SourceView view) {
+    func->instructions.push_back(IrInstruction{op, current, operand, 0, std::move(args), view, false});
+    func->blocks[current].instructions.push_back(func->instructions.size() - 1);
+    return func->instructions.size() - 1;
+}
+
+int IrBuilder::number(double value) {
+    int index = emit(IrNumber);
+    func->instructions[index].number = value;
+    return index;
+}
+
+int IrBuilder::phi(int block) {
+    func->instructions.push_back(IrInstruction{IrPhi, block, 0, 0, {}, {}, false});
+    auto& instructions = func->blocks[block].instructions;
+    instructions.insert(instructions.begin(), func->instructions.size() - 1);
+    return func->instructions.size() - 1;
+}
+
+void IrBuilder::beginScope() {
+    scopeDepth++;
+}
+
+void IrBuilder::endScope() {
+    while (locals.size() && locals.back().depth >= scopeDepth) {
+        locals.pop_back();
+    }
+
+    scopeDepth--;
+}
+
+int IrBuilder::declare(std::string& name) {
+    // Slots line up with the resolver's, the call's own slot comes first
+    locals.push_back(Local{name, scopeDepth});
+    return slotBase + locals.size();
+}
+
+void IrBuilder::writeVariable(int slot, int block, int value) {
+    definitions[block][slot] = value;
+}
+
+int IrBuilder::readVariable(int slot, int block) {
+    auto definition = definitions[block].find(slot);
+    if (definition != definitions[block].end()) {
+        return definition->second;
+    }
+
+    return readVariableRecursive(slot, block);
+}
+
+int IrBuilder::readVariableRecursive(int slot, int block) {
+    int value;
+    auto& preds = func->blocks[block].preds;
+
+    if (!sealed[block]) {
+        value = phi(block);
+        incompletePhis[block][slot] = value;
+    } else if (preds.size() == 1) {
+        value = readVariable(slot, preds[0]);
+    } else if (preds.empty()) {
+        // Only unreachable blocks read a slot nothing has written to
+        func->instructions.push_back(IrInstruction{IrNone, block, 0, 0, {}, {}, false});
+        auto& instructions = func->blocks[block].instructions;
+        instructions.insert(instructions.begin(), func->instructions.size() - 1);
+        value = func->instructions.size() - 1;
+    } else {
+        value = phi(block);
+        writeVariable(slot, block, value);
+        addPhiOperands(slot, value);
+    }
+
+    writeVariable(slot, block, value);
+    return value;
+}
+
+void IrBuilder::addPhiOperands(int slot, int phi) {
+    for (int pred : func->blocks[func->instructions[phi].block].preds) {
+        int value = readVariable(slot, pred);
+        func->instructions[phi].args.push_back(value);
+    }
+}
+
+void IrBuilder::body(std::vector<Stmt>& stmts) {
+    for (Stmt& stmt : stmts) {
+        if (failed) return;
+        statement(stmt);
+    }
+}
+
+void IrBuilder::statement(Stmt& stmt) {
+    switch (stmt.which()) {
+        case Stmt::which<BreakStmt>(): {
+            if (loops.empty()) {
+                failed = true;
+                return;
+            }
+
+            jump(loops.back().exit);
+            unreachable();
+            break;
+        }
+
+        case Stmt::which<ContinueStmt>(): {
+            if (loops.empty()) {
+                failed = true;
+                return;
+            }
+
+            jump(loops.back().header);
+            unreachable();
+            break;
+        }
+
+        case Stmt::which<ExitStmt>(): {
+            double code = stmt.get<ExitStmt>().code.value;
+            if (code > UINT8_MAX) {
+                failed = true;
+                return;
+            }
+
+            emit(IrExit, {}, (int)code);
+            unreachable();
+            break;
+        }
+
+        case Stmt::which<Ptr<ExprStmt>>(): {
+            expression(stmt.get<Ptr<ExprStmt>>()->expr);
+            break;
+        }
+
+        case Stmt::which<Ptr<ReturnStmt>>(): {
+            int value = expression(stmt.get<Ptr<ReturnStmt>>()->value);
+            if (returnBlock != -1) {
+                returns.push_back(value);
+                jump(returnBlock);
+            } else {
+                emit(IrReturn, {value});
+            }
+            unreachable();
+            break;
+        }
+
+        case Stmt::which<Ptr<PrintStmt>>(): {
+            auto& print = stmt.get<Ptr<PrintStmt>>();
+            if (print->exprs.size() > UINT8_MAX) {
+                failed = true;
+                return;
+            }
+
+            std::vector<int> values;
+            for (int i = (signed)print->exprs.size() - 1; i >= 0; i--) {
+                values.push_back(expression(print->exprs[i]));
+            }
+
+            emit(IrPrint, values, values.size(), print->view);
+            break;
+        }
+
+        case Stmt::which<Ptr<IfStmt>>(): {
+            ifStmt(*stmt.get<Ptr<IfStmt>>());
+            break;
+        }
+
+        case Stmt::which<Ptr<LoopBlock>>(): {
+            beginScope();
+            loop(nullptr, stmt.get<Ptr<LoopBlock>>()->body);
+            endScope();
+            break;
+        }
+
+        case Stmt::which<Ptr<WhileLoop>>(): {
+            auto& whileLoop = stmt.get<Ptr<WhileLoop>>();
+            beginScope();
+            loop(&whileLoop->condition, whileLoop->body);
+            endScope();
+            break;
+        }
+
+        case Stmt::which<Ptr<VarDeclaration>>(): {
+            auto& var = stmt.get<Ptr<VarDeclaration>>();
+            int value = var->expr.is<Empty>() ? emit(IrNone) : expression(var->expr);
+            writeVariable(declare(var->target.name), current, value);
+            break;
+        }
+
+        case Stmt::which<Ptr<BlockStmt>>(): {
+            beginScope();
+            body(stmt.get<Ptr<BlockStmt>>()->body);
+            endScope();
+            break;
+        }
+
+        default:
+            failed = true;
+            break;
+    }
+}
+
+void IrBuilder::ifStmt(IfStmt& stmt) {
+    int condition = expression(stmt.condition);
+    int then = newBlock();
+    int orelse = stmt.orelse.size() ? newBlock() : -1;
+    int merge = newBlock();
+    branch(condition, then, orelse == -1 ? merge : orelse);
+
+    sealBlock(then);
+    current = then;
+    body(stmt.body);
+    if (!isTerminated()) {
+        jump(merge);
+    }
+
+    if (orelse != -1) {
+        sealBlock(orelse);
+        current = orelse;
+        body(stmt.orelse);
+        if (!isTerminated()) {
+            jump(merge);
+        }
+    }
+
+    sealBlock(merge);
+    current = merge;
+}
+
+void IrBuilder::loop(Expr* condition, std::vector<Stmt>& stmts) {
+    // Invariant code gets hoisted into the preheader
+    int preheader = newBlock();
+    jump(preheader);
+    sealBlock(preheader);
+    current = preheader;
+
+    int header = newBlock();
+    int exit = newBlock();
+    jump(header);
+    current = header;
+
+    if (condition) {
+        int value = expression(*condition);
+        int loopBody = newBlock();
+        branch(value, loopBody, exit);
+        sealBlock(loopBody);
+        current = loopBody;
+    }
+
+    loops.push_back(Loop{header, exit});
+    body(stmts);
+    loops.pop_back();
+
+    if (!isTerminated()) {
+        jump(header);
+    }
+
+    sealBlock(header);
+    sealBlock(exit);
+    current = exit;
+}
+
+int IrBuilder::expression(Expr& expr) {
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>():
+            return number(expr.get<NumLiteral>().value);
+
+        case Expr::which<BoolLiteral>():
+            return emit(expr.get<BoolLiteral>().value ? IrTrue : IrFalse);
+
+        case Expr::which<StrLiteral>():
+            return emit(IrString, {}, resolution.constants->addName(expr.get<StrLiteral>().value));
+
+        case Expr::which<NoneLiteral>():
+            return emit(IrNone);
+
+        case Expr::which<Identifier>(): {
+            Identifier& id = expr.get<Identifier>();
+            Variable variable = resolution.variables.at(&id);
+
+            switch (variable.kind) {
+                case Variable::Local:
+                    return readVariable(slotBase + variable.index, current);
+                case Variable::UpValue:
+                    return emit(IrGetUpValue, {}, variable.index);
+                default:
+                    return emit(IrGetGlobal, {}, resolution.constants->addName(id.name), id.view);
+            }
+        }
+
+        case Expr::which<Ptr<AssignmentExpr>>():
+            return assignment(*expr.get<Ptr<AssignmentExpr>>());
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            auto& binaryExpr = expr.get<Ptr<BinaryExpr>>();
+            if (binaryExpr->op == BinaryExpr::Operation::And || binaryExpr->op == BinaryExpr::Operation::Or) {
+                return logical(*binaryExpr);
+            }
+
+            return binary(*binaryExpr);
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>(): {
+            auto& unaryExpr = expr.get<Ptr<UnaryExpr>>();
+            int value = expression(unaryExpr->expr);
+            IrOp op = unaryExpr->op == UnaryExpr::Operation::Negative ? IrNegate : IrNot;
+            return emit(op, {value}, 0, unaryExpr->opToken.view);
+        }
+
+        case Expr::which<Ptr<CallExpr>>(): {
+            auto& call = expr.get<Ptr<CallExpr>>();
+            if (call->args.size() > UINT8_MAX) {
+                failed = true;
+                return emit(IrNone);
+            }
+
+            // The call's slot goes below the arguments, it ends up holding the result
+            std::vector<int> args = {emit(IrNone)};
+            for (auto& arg : call->args) {
+                args.push_back(expression(arg));
+            }
+
+            // Methods are looked up and called in one go, without binding them first
+            if (call->target.is<Ptr<PropertyExpr>>()) {
+                auto& prop = call->target.get<Ptr<PropertyExpr>>();
+                args.push_back(expression(prop->expr));
+                int invoke = emit(IrInvoke, args, resolution.constants->addName(prop->prop.name), call->view);
+                func->instructions[invoke].callee = prop->prop.view;
+                return invoke;
+            }
+
+            args.push_back(expression(call->target));
+
+            FuncDeclaration* callee = inlineTarget(*call);
+            if (callee) {
+                return inlineCall(*callee, args, *call);
+            }
+
+            int result = emit(IrCall, args, call->args.size(), call->view);
+            func->instructions[result].callee = getSourceView(call->target);
+            return result;
+        }
+
+        case Expr::which<Ptr<PropertyExpr>>(): {
+            auto& prop = expr.get<Ptr<PropertyExpr>>();
+            int object = expression(prop->expr);
+            return emit(IrGetProperty, {object}, resolution.constants->addName(prop->prop.name), prop->prop.view);
+        }
+
+        default:
+            failed = true;
+            return emit(IrNone);
+    }
+}
+
+int IrBuilder::assignment(AssignmentExpr& assignment) {
+    int value = expression(assignment.expr);
+
+    if (assignment.target.is<Identifier>()) {
+        Identifier& id = assignment.target.get<Identifier>();
+        Variable variable = resolution.variables.at(&id);
+
+        switch (variable.kind) {
+            case Variable::Local:
+                writeVariable(slotBase + variable.index, current, value);
+                return value;
+            case Variable::UpValue:
+                return emit(IrSetUpValue, {value}, variable.index);
+            default:
+                return emit(IrSetGlobal, {value}, resolution.constants->addName(id.name), id.view);
+        }
+    }
+
+    if (assignment.target.is<Ptr<PropertyExpr>>()) {
+        auto& prop = assignment.target.get<Ptr<PropertyExpr>>();
+        int object = expression(prop->expr);
+        return emit(IrSetProperty, {value, object}, resolution.constants->addName(prop->prop.name), prop->prop.view);
+    }
+
+    failed = true;
+    return value;
+}
+
+int IrBuilder::logical(BinaryExpr& binary) {
+    int left = expression(binary.left);
+    int right = newBlock();
+    int merge = newBlock();
+
+    // The left value is the result when it decides the outcome on its own
+    if (binary.op == BinaryExpr::Operation::And) {
+        branch(left, right, merge);
+    } else {
+        branch(left, merge, right);
+    }
+
+    sealBlock(right);
+    current = right;
+    int value = expression(binary.right);
+    jump(merge);
+
+    sealBlock(merge);
+    current = merge;
+    int result = phi(merge);
+    func->instructions[result].args = {left, value};
+    return result;
+}
+
+int IrBuilder::binary(BinaryExpr& binary) {
+    int left = expression(binary.left);
+    int right = expression(binary.right);
+
+    IrOp op;
+    switch (binary.op) {
+        case BinaryExpr::Operation::Add: op = IrAdd; break;
+        case BinaryExpr::Operation::Subtract: op = IrSubtract; break;
+        case BinaryExpr::Operation::Modulous: op = IrModulous; break;
+        case BinaryExpr::Operation::Multiply: op = IrMultiply; break;
+        case BinaryExpr::Operation::Divide: op = IrDivide; break;
+        case BinaryExpr::Operation::Exponent: op = IrExponent; break;
+        case BinaryExpr::Operation::GreaterThan: op = IrGreater; break;
+        case BinaryExpr::Operation::LessThan: op = IrLess; break;
+        case BinaryExpr::Operation::GreaterThanOrEq: op = IrGreaterThanOrEq; break;
+        case BinaryExpr::Operation::LessThanOrEq: op = IrLessThanOrEq; break;
+        case BinaryExpr::Operation::Equal: op = IrEqual; break;
+        default: op = IrNotEqual; break;
+    }
+
+    return emit(op, {left, right}, 0, binary.opToken.view);
+}
+
+static int inlineCost(Expr& expr);
+
+// How many nodes a body has, or -1 when it has something that can't be inlined
+static int inlineCost(std::vector<Stmt>& stmts) {
+    int cost = 0;
+    auto add = [&](int more) {
+        cost = cost == -1 || more == -1 ? -1 : cost + more;
+    };
+
+    for (Stmt& stmt : stmts) {
+        switch (stmt.which()) {
+            case Stmt::which<BreakStmt>():
+            case Stmt::which<ContinueStmt>():
+            case Stmt::which<ExitStmt>():
+                add(1);
+                break;
+
+            case Stmt::which<Ptr<ExprStmt>>():
+                add(inlineCost(stmt.get<Ptr<ExprStmt>>()->expr));
+                break;
+
+            case Stmt::which<Ptr<ReturnStmt>>():
+                add(1);
+                add(inlineCost(stmt.get<Ptr<ReturnStmt>>()->value));
+                break;
+
+            case Stmt::which<Ptr<PrintStmt>>():
+                add(1);
+                for (auto& expr : stmt.get<Ptr<PrintStmt>>()->exprs) {
+                    add(inlineCost(expr));
+                }
+                break;
+
+            case Stmt::which<Ptr<IfStmt>>(): {
+                auto& ifStmt = stmt.get<Ptr<IfStmt>>();
+                add(1);
+                add(inlineCost(ifStmt->condition));
+                add(inlineCost(ifStmt->body));
+                add(inlineCost(ifStmt->orelse));
+                break;
+            }
+
+            case Stmt::which<Ptr<LoopBlock>>():
+                add(1);
+                add(inlineCost(stmt.get<Ptr<LoopBlock>>()->body));
+                break;
+
+            case Stmt::which<Ptr<WhileLoop>>():
+                add(1);
+                add(inlineCost(stmt.get<Ptr<WhileLoop>>()->condition));
+                add(inlineCost(stmt.get<Ptr<WhileLoop>>()->body));
+                break;
+
+            case Stmt::which<Ptr<VarDeclaration>>(): {
+                auto& var = stmt.get<Ptr<VarDeclaration>>();
+                add(1);
+                add(var->expr.is<Empty>() ? 0 : inlineCost(var->expr));
+                break;
+            }
+
+            case Stmt::which<Ptr<BlockStmt>>():
+                add(inlineCost(stmt.get<Ptr<BlockStmt>>()->body));
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    return cost;
+}
+
+static int inlineCost(Expr& expr) {
+    auto sum = [](int a, int b) {
+        return a == -1 || b == -1 ? -1 : a + b + 1;
+    };
+
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>():
+        case Expr::which<BoolLiteral>():
+        case Expr::which<StrLiteral>():
+        case Expr::which<NoneLiteral>():
+        case Expr::which<Identifier>():
+            return 1;
+
+        case Expr::which<Ptr<AssignmentExpr>>(): {
+            auto& assignment = expr.get<Ptr<AssignmentExpr>>();
+            int target = 0;
+            if (assignment->target.is<Ptr<PropertyExpr>>()) {
+                target = inlineCost(assignment->target.get<Ptr<PropertyExpr>>()->expr);
+            } else if (!assignment->target.is<Identifier>()) {
+                return -1;
+            }
+            return sum(inlineCost(assignment->expr), target);
+        }
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            auto& binaryExpr = expr.get<Ptr<BinaryExpr>>();
+            return sum(inlineCost(binaryExpr->left), inlineCost(binaryExpr->right));
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>():
+            return sum(inlineCost(expr.get<Ptr<UnaryExpr>>()->expr), 0);
+
+        case Expr::which<Ptr<PropertyExpr>>():
+            return sum(inlineCost(expr.get<Ptr<PropertyExpr>>()->expr), 0);
+
+        // Only leaf functions are inlined, which also rules out recursion
+        default:
+            return -1;
+    }
+}
+
+FuncDeclaration* IrBuilder::inlineTarget(CallExpr& call) {
+    if (!context.inlineTable || returnBlock != -1 || !call.target.is<Identifier>()) {
+        return nullptr;
+    }
+
+    Identifier& id = call.target.get<Identifier>();
+    auto found = context.inlineTable->find(id.name);
+    if (resolution.variables.at(&id).kind != Variable::Global || found == context.inlineTable->end()) {
+        return nullptr;
+    }
+
+    FuncDeclaration& callee = *found->second.decl;
+    if (&callee == function || callee.args.size() != call.args.size() || found->second.prot.expired()) {
+        return nullptr;
+    }
+
+    int cost = inlineCost(callee.body);
+    if (cost == -1 || cost > inline_cost_max) {
+        return nullptr;
+    }
+
+    // Lazily compiled callers start from an empty resolution, and they are never compiled in parallel
+    if (!resolution.upValues.count(&callee)) {
+        Resolver resolver = Resolver(path);
+        resolver.resolveFunction(*context.ast, callee, resolution);
+        if (resolver.failed()) {
+            return nullptr;
+        }
+    }
+
+    return &callee;
+}
+
+int IrBuilder::inlineCall(FuncDeclaration& callee, std::vector<int>& args, CallExpr& call) {
+    int check = emit(IrCheckFunction, {args.back()}, func->prototypes.size());
+    func->prototypes.push_back(context.inlineTable->at(callee.name.name).prot.lock());
+
+    int inlined = newBlock();
+    int slow = newBlock();
+    int merge = newBlock();
+    branch(check, inlined, slow);
+
+    // The global was reassigned since this was compiled, so it's called like normal
+    sealBlock(slow);
+    current = slow;
+    returns = {emit(IrCall, args, call.args.size(), call.view)};
+    func->instructions[returns[0]].callee = getSourceView(call.target);
+    jump(merge);
+
+    std::vector<Local> enclosingLocals = std::move(locals);
+    std::vector<Loop> enclosingLoops = std::move(loops);
+    int enclosingDepth = scopeDepth;
+
+    // The callee's locals get their own range of slots so they never clash with the caller's
+    locals.clear();
+    loops.clear();
+    scopeDepth = 0;
+    slotBase = ++inlineCount << 16;
+    returnBlock = merge;
+
+    sealBlock(inlined);
+    current = inlined;
+    beginScope();
+    for (int i = 0; i < (signed)callee.args.size(); i++) {
+        writeVariable(declare(callee.args[i].name), current, args[i + 1]);
+    }
+
+    body(callee.body);
+
+    if (!isTerminated()) {
+        returns.push_back(emit(IrNone));
+        jump(merge);
+    }
+
+    locals = std::move(enclosingLocals);
+    loops = std::move(enclosingLoops);
+    scopeDepth = enclosingDepth;
+    slotBase = 0;
+    returnBlock = -1;
+
+    sealBlock(merge);
+    current = merge;
+    int result = phi(merge);
+    func->instructions[result].args = std::move(returns);
+    return result;
+}
@@ -0,0 +1,479 @@
+#include "compiler/ircompiler.h"
+#include "compiler/optimizer.h"
+#include "print.h"
+#include <algorithm>
+#include <set>
+
+bool IrCompiler::compileFunction(FuncDeclaration& stmt, Prototype& prot) {
+    // The ir has no slot for the instance methods are called on
+    if (stmt.method) {
+        return false;
+    }
+
+    IrBuilder builder = IrBuilder(*context, path);
+    if (!builder.build(stmt, ir)) {
+        return false;
+    }
+
+    optimizeIr(ir, options.optimizeLevel);
+    splitCriticalEdges(ir);
+
+    if (options.dumpIr) {
+        std::unique_lock<std::mutex> lock(context->mutex);
+        printIr(ir);
+    }
+
+    hadError = false;
+    newChunk();
+    chunkData->name = ir.name;
+    getChunk()->prototypes = ir.prototypes;
+
+    layout = reversePostorder(ir);
+    position.assign(ir.blocks.size(), -1);
+    for (int i = 0; i < (signed)layout.size(); i++) {
+        position[layout[i]] = i;
+    }
+
+    uses = countUses(ir);
+    numbers = inferNumbers(ir);
+    stackify();
+    allocateSlots();
+
+    // Slots past the arguments have to exist before anything else is pushed
+    for (int slot = ir.argc + 1; slot < slotCount; slot++) {
+        emitByte(OpNone);
+    }
+
+    starts.assign(ir.blocks.size(), -1);
+    pendingJumps.assign(ir.blocks.size(), {});
+    for (int index : layout) {
+        block(index);
+    }
+
+    prot.slots = slotCount;
+    prot.chunk = endChunk();
+
+    if (hadError) {
+        std::unique_lock<std::mutex> lock(context->mutex);
+        context->errors.push_back(error);
+    }
+
+    return true;
+}
+
+bool IrCompiler::isEmitted(int index) {
+    IrOp op = ir.instructions[index].op;
+    return !ir.instructions[index].removed && !isConstant(op) && op != IrPhi && op != IrParam;
+}
+
+bool IrCompiler::needsSlot(int index) {
+    auto& inst = ir.instructions[index];
+    if (inst.removed || uses[index] == 0) return false;
+
+    if (inst.op == IrPhi || inst.op == IrParam) return true;
+    return isEmitted(index) && producesValue(inst.op) && !stacked[index];
+}
+
+void IrCompiler::stackify() {
+    // A value used once by the very next instruction in its block is left on the stack for it,
+    // constants and values in slots don't count since they get pushed again right where they're used
+    stacked.assign(ir.instructions.size(), false);
+    std::vector<int> treeStart(ir.instructions.size());
+
+    for (int index : layout) {
+        std::vector<int> visible;
+        for (int inst : ir.blocks[index].instructions) {
+            if (isEmitted(inst)) visible.push_back(inst);
+        }
+
+        for (int pos = 0; pos < (signed)visible.size(); pos++) {
+            auto& args = ir.instructions[visible[pos]].args;
+            int start = pos;
+
+            for (int i = (signed)args.size() - 1; i >= 0; i--) {
+                int arg = args[i];
+                if (start == 0 || visible[start - 1] != arg || uses[arg] != 1) continue;
+
+                stacked[arg] = true;
+                start = treeStart[arg];
+            }
+
+            treeStart[visible[pos]] = start;
+        }
+    }
+}
+
+void IrCompiler::allocateSlots() {
+    int count = ir.instructions.size();
+    slots.assign(count, -1);
+
+    // Liveness of values that live in slots, phis belong to their own block and their
+    // operands are used at the end of the matching predecessor
+    std::vector<std::set<int>> liveIn(ir.blocks.size()), liveOut(ir.blocks.size());
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = (signed)layout.size() - 1; i >= 0; i--) {
+            int index = layout[i];
+            auto& block = ir.blocks[index];
+            std::set<int> out;
+
+            for (int succ : block.succs) {
+                out.insert(liveIn[succ].begin(), liveIn[succ].end());
+
+                int pred = std::find(ir.blocks[succ].preds.begin(), ir.blocks[succ].preds.end(), index) - ir.blocks[succ].preds.begin();
+                for (int inst : ir.blocks[succ].instructions) {
+                    if (ir.instructions[inst].op != IrPhi) break;
+
+                    int arg = ir.instructions[inst].args[pred];
+                    if (needsSlot(arg)) out.insert(arg);
+                }
+            }
+
+            std::set<int> in;
+            for (int value : out) {
+                if (ir.instructions[value].block != index) in.insert(value);
+            }
+
+            for (int inst : block.instructions) {
+                if (ir.instructions[inst].op == IrPhi) continue;
+
+                for (int arg : ir.instructions[inst].args) {
+                    if (needsSlot(arg) && ir.instructions[arg].block != index) in.insert(arg);
+                }
+            }
+
+            if (in != liveIn[index] || out != liveOut[index]) {
+                liveIn[index] = std::move(in);
+                liveOut[index] = std::move(out);
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<int> phiUser(count, -1);
+    for (int i = 0; i < count; i++) {
+        if (ir.instructions[i].removed || ir.instructions[i].op != IrPhi) continue;
+
+        for (int arg : ir.instructions[i].args) {
+            phiUser[arg] = i;
+        }
+    }
+
+    // Slot 0 holds the function itself
+    std::vector<int> owner = {0};
+    auto isFree = [&](int slot) {
+        return slot >= (signed)owner.size() || owner[slot] == -1;
+    };
+
+    auto take = [&](int value, int slot) {
+        if (slot >= (signed)owner.size()) owner.resize(slot + 1, -1);
+        owner[slot] = value;
+        slots[value] = slot;
+    };
+
+    auto lowestFree = [&]() {
+        int slot = 1;
+        while (!isFree(slot)) slot++;
+        return slot;
+    };
+
+    slotCount = ir.argc + 1;
+    for (int index : layout) {
+        auto& block = ir.blocks[index];
+        std::fill(owner.begin() + 1, owner.end(), -1);
+
+        for (int value : liveIn[index]) {
+            take(value, slots[value]);
+        }
+
+        std::unordered_map<int, int> lastUse;
+        for (int pos = 0; pos < (signed)block.instructions.size(); pos++) {
+            auto& inst = ir.instructions[block.instructions[pos]];
+            if (inst.op == IrPhi) continue;
+
+            for (int arg : inst.args) {
+                if (needsSlot(arg) && !liveOut[index].count(arg)) lastUse[arg] = pos;
+            }
+        }
+
+        for (int pos = 0; pos < (signed)block.instructions.size(); pos++) {
+            int value = block.instructions[pos];
+            auto& inst = ir.instructions[value];
+
+            if (inst.op != IrPhi) {
+                for (int arg : inst.args) {
+                    auto last = lastUse.find(arg);
+                    if (last != lastUse.end() && last->second == pos && owner[slots[arg]] == arg) {
+                        owner[slots[arg]] = -1;
+                    }
+                }
+            }
+
+            if (!needsSlot(value)) continue;
+
+            if (inst.op == IrParam) {
+                take(value, inst.operand);
+                continue;
+            }
+
+            // Sharing a slot with a phi or its operands saves the copy between them
+            int slot = -1;
+            if (inst.op == IrPhi) {
+                for (int arg : inst.args) {
+                    if (slots[arg] != -1 && isFree(slots[arg])) {
+                        slot = slots[arg];
+                        break;
+                    }
+                }
+            } else if (phiUser[value] != -1 && slots[phiUser[value]] != -1 && isFree(slots[phiUser[value]])) {
+                slot = slots[phiUser[value]];
+            }
+
+            take(value, slot == -1 ? lowestFree() : slot);
+        }
+
+        slotCount = std::max(slotCount, (int)owner.size());
+    }
+}
+
+void IrCompiler::block(int index) {
+    currentBlock = index;
+    starts[index] = getChunk()->bytecode.size();
+    for (int jump : pendingJumps[index]) {
+        patchJump(jump);
+    }
+
+    for (int inst : ir.blocks[index].instructions) {
+        if (!isEmitted(inst) || stacked[inst]) continue;
+
+        if (isTerminator(ir.instructions[inst].op)) {
+            terminate(inst);
+            continue;
+        }
+
+        tree(inst);
+
+        if (!producesValue(ir.instructions[inst].op)) continue;
+
+        if (slots[inst] != -1) {
+            emitInstruction(OpSetLocal, slots[inst]);
+        }
+        emitByte(OpPop);
+    }
+}
+
+void IrCompiler::terminate(int index) {
+    auto& inst = ir.instructions[index];
+    auto& succs = ir.blocks[currentBlock].succs;
+
+    switch (inst.op) {
+        case IrJump: {
+            phiCopies(currentBlock, succs[0]);
+            jumpTo(succs[0]);
+            break;
+        }
+
+        case IrBranch: {
+            argument(inst.args[0]);
+            int ifFalse = succs[1];
+
+            if (starts[ifFalse] == -1) {
+                pendingJumps[ifFalse].push_back(emitJumpForwards(OpJumpPopIfFalse));
+                jumpTo(succs[0]);
+                break;
+            }
+
+            // Conditional jumps only go forwards
+            int skip = emitJumpForwards(OpJumpPopIfFalse);
+            jumpTo(succs[0], true);
+            patchJump(skip);
+            emitJumpBackwards(OpJumpBack, starts[ifFalse]);
+            break;
+        }
+
+        case IrReturn: {
+            argument(inst.args[0]);
+            emitByte(OpReturn);
+            break;
+        }
+
+        default: {
+            emitByte(OpExit, (u8)inst.operand);
+            break;
+        }
+    }
+}
+
+void IrCompiler::phiCopies(int from, int to) {
+    auto& preds = ir.blocks[to].preds;
+    int pred = std::find(preds.begin(), preds.end(), from) - preds.begin();
+
+    // Every source is pushed before any phi is written, so copies that swap slots still work
+    std::vector<int> phis;
+    for (int inst : ir.blocks[to].instructions) {
+        auto& phi = ir.instructions[inst];
+        if (phi.op != IrPhi) break;
+
+        if (slots[inst] == -1 || slots[inst] == slots[phi.args[pred]]) continue;
+
+        load(phi.args[pred]);
+        phis.push_back(inst);
+    }
+
+    for (int i = (signed)phis.size() - 1; i >= 0; i--) {
+        emitInstruction(OpSetLocal, slots[phis[i]]);
+        emitByte(OpPop);
+    }
+}
+
+void IrCompiler::jumpTo(int target, bool force) {
+    if (!force && position[target] == position[currentBlock] + 1) return;
+
+    if (starts[target] != -1) {
+        emitJumpBackwards(OpJumpBack, starts[target]);
+    } else {
+        pendingJumps[target].push_back(emitJumpForwards(OpJump));
+    }
+}
+
+void IrCompiler::tree(int index) {
+    for (int arg : ir.instructions[index].args) {
+        argument(arg);
+    }
+
+    operation(index);
+}
+
+void IrCompiler::argument(int index) {
+    if (stacked[index]) {
+        tree(index);
+    } else {
+        load(index);
+    }
+}
+
+void IrCompiler::load(int index) {
+    auto& inst = ir.instructions[index];
+
+    switch (inst.op) {
+        case IrNumber: {
+            if (!fitsInByte(inst.number)) {
+                emitInstruction(OpNumber, makeNumberConstant(inst.number, inst.view));
+            } else {
+                emitByte(OpByteNumber, (u8)inst.number);
+            }
+            break;
+        }
+
+        case IrString:
+            emitInstruction(OpName, inst.operand);
+            break;
+        case IrTrue:
+            emitByte(OpTrue);
+            break;
+        case IrFalse:
+            emitByte(OpFalse);
+            break;
+        case IrNone:
+            emitByte(OpNone);
+            break;
+
+        default: {
+            if (slots[index] == -1) {
+                internalError("Value used without a slot");
+                return;
+            }
+
+            emitInstruction(OpGetLocal, slots[index]);
+            break;
+        }
+    }
+}
+
+bool IrCompiler::numeric(IrInstruction& inst) {
+    return std::all_of(inst.args.begin(), inst.args.end(), [&](int arg) { return numbers[arg]; });
+}
+
+void IrCompiler::operation(int index) {
+    auto& inst = ir.instructions[index];
+
+    // Operands proven to be numbers get the opcodes that skip type checks
+    if (numeric(inst)) {
+        switch (inst.op) {
+            case IrAdd: emitByte(OpAddNumbers); return;
+            case IrSubtract: emitByte(OpSubtractNumbers); return;
+            case IrMultiply: emitByte(OpMultiplyNumbers); return;
+            case IrDivide: marker(inst.view); emitByte(OpDivideNumbers); return;
+            case IrGreater: emitByte(OpGreaterNumbers); return;
+            case IrLess: emitByte(OpLessNumbers); return;
+            case IrGreaterThanOrEq: emitByte(OpGreaterThanOrEqNumbers); return;
+            case IrLessThanOrEq: emitByte(OpLessThanOrEqNumbers); return;
+            case IrNegate: emitByte(OpNegateNumber); return;
+            default: break;
+        }
+    }
+
+    switch (inst.op) {
+        case IrAdd: marker(inst.view); emitByte(OpAdd); break;
+        case IrSubtract: marker(inst.view); emitByte(OpSubtract); break;
+        case IrModulous: marker(inst.view); emitByte(OpModulous); break;
+        case IrMultiply: marker(inst.view); emitByte(OpMultiply); break;
+        case IrDivide: marker(inst.view); emitByte(OpDivide); break;
+        case IrExponent: marker(inst.view); emitByte(OpExponent); break;
+        case IrEqual: emitByte(OpEqual); break;
+        case IrNotEqual: emitByte(OpNotEqual); break;
+        case IrGreater: marker(inst.view); emitByte(OpGreater); break;
+        case IrLess: marker(inst.view); emitByte(OpLess); break;
+        case IrGreaterThanOrEq: marker(inst.view); emitByte(OpGreaterThanOrEq); break;
+        case IrLessThanOrEq: marker(inst.view); emitByte(OpLessThanOrEq); break;
+        case IrNot: emitByte(OpNot); break;
+        case IrNegate: marker(inst.view); emitByte(OpNegate); break;
+
+        case IrGetGlobal:
+            marker(inst.view);
+            emitInstruction(OpGetGlobal, inst.operand);
+            break;
+        case IrSetGlobal:
+            marker(inst.view);
+            emitInstruction(OpSetGlobal, inst.operand);
+            break;
+        case IrGetUpValue:
+            emitInstruction(OpGetUpValue, inst.operand);
+            break;
+        case IrSetUpValue:
+            emitInstruction(OpSetUpValue, inst.operand);
+            break;
+        case IrGetProperty:
+            marker(inst.view);
+            emitProperty(OpGetProperty, inst.operand);
+            break;
+        case IrSetProperty:
+            marker(inst.view);
+            emitProperty(OpSetProperty, inst.operand);
+            break;
+
+        case IrCall:
+            marker(inst.callee);
+            emitByte(OpCall);
+            marker(inst.view);
+            emitByte((u8)inst.operand);
+            break;
+        case IrInvoke:
+            marker(inst.callee);
+            emitProperty(OpInvoke, inst.operand);
+            marker(inst.view);
+            emitByte((u8)(inst.args.size() - 2));
+            break;
+        case IrCheckFunction:
+            emitInstruction(OpCheckFunction, inst.operand);
+            break;
+        case IrPrint:
+            emitByte(OpPrint, (u8)inst.operand);
+            break;
+
+        default:
+            internalError("Invalid ir instruction");
+            break;
+    }
+}
@@ -0,0 +1,264 @@
+#include "compiler/optimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+std::vector<IrPass>& irPipeline() {
+    static std::vector<IrPass> pipeline = {
+        {"copy-propagation", 1, propagateCopies},
+        {"licm", 2, hoistLoopInvariants},
+        {"cse", 2, eliminateCommonSubexpressions},
+        {"copy-propagation", 1, propagateCopies},
+        {"dce", 1, eliminateDeadCode},
+    };
+
+    return pipeline;
+}
+
+void optimizeIr(IrFunction& func, int level) {
+    for (auto& pass : irPipeline()) {
+        if (level >= pass.level) {
+            pass.run(func);
+        }
+    }
+}
+
+void propagateCopies(IrFunction& func) {
+    std::vector<int> replacements(func.instructions.size(), -1);
+
+    // A phi whose operands are all the same value, or itself, is just a copy of that value
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (int i = 0; i < (signed)func.instructions.size(); i++) {
+            auto& inst = func.instructions[i];
+            if (inst.removed || inst.op != IrPhi) continue;
+
+            int value = -1;
+            bool trivial = true;
+            for (int& arg : inst.args) {
+                arg = resolveReplacement(replacements, arg);
+                if (arg == i || arg == value) continue;
+
+                if (value != -1) {
+                    trivial = false;
+                    break;
+                }
+                value = arg;
+            }
+
+            if (!trivial || value == -1) continue;
+
+            replacements[i] = value;
+            inst.removed = true;
+            changed = true;
+        }
+    }
+
+    replaceUses(func, replacements);
+    removeMarked(func);
+}
+
+static bool isPure(IrOp op) {
+    switch (op) {
+        case IrNumber:
+        case IrString:
+        case IrTrue:
+        case IrFalse:
+        case IrNone:
+        case IrAdd:
+        case IrSubtract:
+        case IrModulous:
+        case IrMultiply:
+        case IrDivide:
+        case IrExponent:
+        case IrEqual:
+        case IrNotEqual:
+        case IrGreater:
+        case IrLess:
+        case IrGreaterThanOrEq:
+        case IrLessThanOrEq:
+        case IrNot:
+        case IrNegate:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void eliminateCommonSubexpressions(IrFunction& func) {
+    using Key = std::tuple<int, int, u64, std::vector<int>>;
+    std::map<Key, int> available;
+    std::vector<int> replacements(func.instructions.size(), -1);
+
+    std::vector<int> idoms = immediateDominators(func);
+    std::vector<std::vector<int>> children(func.blocks.size());
+    for (int block = 1; block < (signed)func.blocks.size(); block++) {
+        if (idoms[block] != -1) {
+            children[idoms[block]].push_back(block);
+        }
+    }
+
+    // Walks the dominator tree, a value is available to every block its own block dominates
+    std::vector<std::vector<Key>> added(func.blocks.size());
+    std::vector<std::pair<int, bool>> stack = {{0, false}};
+
+    while (stack.size()) {
+        auto [block, leaving] = stack.back();
+        stack.pop_back();
+
+        if (leaving) {
+            for (auto& key : added[block]) {
+                available.erase(key);
+            }
+            continue;
+        }
+
+        for (int index : func.blocks[block].instructions) {
+            auto& inst = func.instructions[index];
+            if (!isPure(inst.op)) continue;
+
+            // Operands come from dominating blocks, which have already been visited
+            for (int& arg : inst.args) {
+                arg = resolveReplacement(replacements, arg);
+            }
+
+            u64 bits;
+            std::memcpy(&bits, &inst.number, sizeof(bits));
+            Key key = {inst.op, inst.operand, bits, inst.args};
+
+            auto found = available.find(key);
+            if (found != available.end()) {
+                replacements[index] = found->second;
+                inst.removed = true;
+                continue;
+            }
+
+            available[key] = index;
+            added[block].push_back(key);
+        }
+
+        stack.push_back({block, true});
+        for (int child : children[block]) {
+            stack.push_back({child, false});
+        }
+    }
+
+    replaceUses(func, replacements);
+    removeMarked(func);
+}
+
+void hoistLoopInvariants(IrFunction& func) {
+    std::vector<int> order = reversePostorder(func);
+    std::vector<int> idoms = immediateDominators(func);
+    std::vector<bool> numbers = inferNumbers(func);
+
+    // Inner loops have later headers, hoisting out of them first lets code move out of several loops
+    for (int i = (signed)order.size() - 1; i >= 0; i--) {
+        int header = order[i];
+        std::vector<bool> inLoop(func.blocks.size());
+        std::vector<int> worklist;
+
+        for (int pred : func.blocks[header].preds) {
+            if (dominates(idoms, header, pred)) {
+                worklist.push_back(pred);
+            }
+        }
+
+        if (worklist.empty()) continue;
+
+        inLoop[header] = true;
+        while (worklist.size()) {
+            int block = worklist.back();
+            worklist.pop_back();
+            if (inLoop[block]) continue;
+
+            inLoop[block] = true;
+            for (int pred : func.blocks[block].preds) {
+                worklist.push_back(pred);
+            }
+        }
+
+        int preheader = -1;
+        for (int pred : func.blocks[header].preds) {
+            if (inLoop[pred]) continue;
+
+            if (preheader != -1 || func.blocks[pred].succs.size() != 1) {
+                preheader = -1;
+                break;
+            }
+            preheader = pred;
+        }
+
+        if (preheader == -1) continue;
+
+        // Only code that can't throw is moved, an error has to come from where it was written
+        std::vector<int> hoisted;
+        for (bool changed = true; changed;) {
+            changed = false;
+
+            for (int block : order) {
+                if (!inLoop[block]) continue;
+
+                std::vector<int> kept;
+                for (int index : func.blocks[block].instructions) {
+                    auto& inst = func.instructions[index];
+                    bool invariant = isPure(inst.op) && !canTrap(func, numbers, index) && std::none_of(inst.args.begin(), inst.args.end(), [&](int arg) {
+                        return inLoop[func.instructions[arg].block];
+                    });
+
+                    if (invariant) {
+                        inst.block = preheader;
+                        hoisted.push_back(index);
+                        changed = true;
+                    } else {
+                        kept.push_back(index);
+                    }
+                }
+
+                func.blocks[block].instructions = std::move(kept);
+            }
+        }
+
+        auto& instructions = func.blocks[preheader].instructions;
+        instructions.insert(terminator(func, preheader) == -1 ? instructions.end() : instructions.end() - 1, hoisted.begin(), hoisted.end());
+    }
+}
+
+void eliminateDeadCode(IrFunction& func) {
+    std::vector<bool> numbers = inferNumbers(func);
+    std::vector<bool> live(func.instructions.size());
+    std::vector<int> worklist;
+
+    for (int i = 0; i < (signed)func.instructions.size(); i++) {
+        auto& inst = func.instructions[i];
+        if (inst.removed) continue;
+
+        if (hasSideEffects(inst.op) || canTrap(func, numbers, i)) {
+            live[i] = true;
+            worklist.push_back(i);
+        }
+    }
+
+    while (worklist.size()) {
+        int index = worklist.back();
+        worklist.pop_back();
+
+        for (int arg : func.instructions[index].args) {
+            if (!live[arg]) {
+                live[arg] = true;
+                worklist.push_back(arg);
+            }
+        }
+    }
+
+    for (int i = 0; i < (signed)func.instructions.size(); i++) {
+        if (!live[i]) {
+            func.instructions[i].removed = true;
+        }
+    }
+
+    removeMarked(func);
+}
@@ -0,0 +1,181 @@
+#include "compiler/peephole.h"
+#include "compiler/assembler.h"
+
+using InstructionList = std::vector<AssembledInstruction>;
+
+static bool isRemoved(AssembledInstruction& inst) {
+    return inst.length == 0;
+}
+
+static void remove(AssembledInstruction& inst) {
+    inst.length = 0;
+    inst.target = -1;
+}
+
+static int nextInstruction(InstructionList& instructions, int index) {
+    while (index < (signed)instructions.size() - 1 && isRemoved(instructions[index])) {
+        index++;
+    }
+
+    return index;
+}
+
+// Instructions that only push a value, so popping it right away does nothing
+static bool isPurePush(u8 instruction) {
+    switch (instruction) {
+        case OpNone:
+        case OpTrue:
+        case OpFalse:
+        case OpByteNumber:
+        case OpNumber:
+        case OpName:
+        case OpGetLocal:
+        case OpGetUpValue:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool isTerminator(u8 instruction) {
+    switch (instruction) {
+        case OpJump:
+        case OpJumpBack:
+        case OpExit:
+        case OpReturn:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool hasZeroOperand(const Chunk& chunk, AssembledInstruction& inst) {
+    int operand = inst.start + 1;
+    if (chunk.bytecode[inst.start] == OpWide) {
+        return chunk.bytecode[operand + 1] == 0 && chunk.bytecode[operand + 2] == 0;
+    }
+
+    return chunk.bytecode[operand] == 0;
+}
+
+// OpReturn drops the whole frame, so locals popped right before it don't need to be
+static bool returnsAfter(InstructionList& instructions, std::vector<bool>& targets, int index) {
+    if (targets[index]) {
+        return false;
+    }
+
+    if (isPurePush(instructions[index].instruction) && !targets[index + 1]) {
+        index++;
+    }
+
+    return instructions[index].instruction == OpReturn;
+}
+
+static void threadJumps(InstructionList& instructions) {
+    for (int i = 0; i < (signed)instructions.size(); i++) {
+        auto& inst = instructions[i];
+        if (inst.target == -1) continue;
+
+        bool unconditional = inst.instruction == OpJump || inst.instruction == OpJumpBack;
+
+        // A conditional jump can only follow one of its own kind, the value it tested is still on the stack.
+        // Loop jumps test their own slots, so they only follow unconditional jumps.
+        // Bounded so jumps that form a cycle don't hang the compiler
+        for (int hops = 0; hops < 16; hops++) {
+            auto& next = instructions[inst.target];
+            bool follows = next.instruction == OpJump || next.instruction == OpJumpBack;
+            bool sameTest = next.instruction == inst.instruction && inst.instruction != OpJumpPopIfFalse && !isLoopJump(inst.instruction);
+
+            if (next.target == -1 || next.target == inst.target || !(follows || sameTest)) {
+                break;
+            }
+
+            // Only unconditional jumps can change direction
+            if (!unconditional && (next.target <= i) != jumpsBack(inst.instruction)) {
+                break;
+            }
+
+            inst.target = next.target;
+        }
+
+        if (unconditional) {
+            inst.instruction = inst.target > i ? OpJump : OpJumpBack;
+        }
+    }
+}
+
+static void rewriteSequences(const Chunk& chunk, InstructionList& instructions, std::vector<bool>& targets) {
+    for (int i = 0; i < (signed)instructions.size() - 1; i++) {
+        auto& inst = instructions[i];
+        if (isRemoved(inst)) continue;
+
+        if (inst.instruction == OpPopLocals && (hasZeroOperand(chunk, inst) || returnsAfter(instructions, targets, i + 1))) {
+            remove(inst);
+            continue;
+        }
+
+        auto& next = instructions[i + 1];
+        if (isRemoved(next) || targets[i + 1]) continue;
+
+        if (inst.instruction == OpEqual && next.instruction == OpNot) {
+            inst.instruction = OpNotEqual;
+            remove(next);
+        } else if (isPurePush(inst.instruction) && next.instruction == OpPop) {
+            remove(inst);
+            remove(next);
+        }
+    }
+}
+
+static void removeUnreachable(InstructionList& instructions, std::vector<bool>& targets) {
+    bool reachable = true;
+    for (int i = 0; i < (signed)instructions.size() - 1; i++) {
+        auto& inst = instructions[i];
+        reachable = reachable || targets[i];
+
+        if (!reachable) {
+            remove(inst);
+        } else if (!isRemoved(inst) && isTerminator(inst.instruction)) {
+            reachable = false;
+        }
+    }
+}
+
+static void removeEmptyJumps(InstructionList& instructions) {
+    for (int i = 0; i < (signed)instructions.size() - 1; i++) {
+        auto& inst = instructions[i];
+        if (inst.target <= i || isLoopJump(inst.instruction)) continue;
+
+        if (nextInstruction(instructions, i + 1) != nextInstruction(instructions, inst.target)) {
+            continue;
+        }
+
+        // Jumping to the next instruction still has to drop the condition
+        if (inst.instruction == OpJumpPopIfFalse) {
+            inst.instruction = OpPop;
+            inst.length = 1;
+            inst.target = -1;
+        } else {
+            remove(inst);
+        }
+    }
+}
+
+void optimizeChunk(Chunk& chunk) {
+    InstructionList instructions = decodeChunk(chunk);
+    threadJumps(instructions);
+
+    std::vector<bool> targets(instructions.size());
+    for (auto& inst : instructions) {
+        if (inst.target != -1) {
+            targets[inst.target] = true;
+        }
+    }
+
+    rewriteSequences(chunk, instructions, targets);
+    removeUnreachable(instructions, targets);
+    removeEmptyJumps(instructions);
+    encodeChunk(chunk, instructions);
+}
@@ -0,0 +1,485 @@
+#include "compiler/resolver.h"
+
+void Resolver::resolve(Ast& ast, Resolution& resolution) {
+    this->resolution = &resolution;
+    hadError = false;
+    declareConstants(ast);
+
+    newFunction();
+    data->localOffset = 0;
+    body(ast.body);
+    endFunction();
+}
+
+void Resolver::resolveFunction(Ast& ast, FuncDeclaration& stmt, Resolution& resolution) {
+    this->resolution = &resolution;
+    hadError = false;
+    declareConstants(ast);
+
+    newFunction();
+    data->localOffset = 0;
+    funcDeclaration(stmt);
+    endFunction();
+}
+
+void Resolver::declareConstants(Ast& ast) {
+    // Constants are known up front so functions declared before them can't assign to them either
+    for (Stmt& stmt : ast.body) {
+        if (stmt.is<Ptr<VarDeclaration>>() && stmt.get<Ptr<VarDeclaration>>()->constant) {
+            Identifier& target = stmt.get<Ptr<VarDeclaration>>()->target;
+            resolution->constantGlobals.emplace(target.name, target.view.index);
+        }
+    }
+}
+
+bool Resolver::failed() {
+    return hadError;
+}
+
+Error Resolver::getError() {
+    return error;
+}
+
+void Resolver::newFunction() {
+    std::unique_ptr<ResolverData> enclosing = std::move(data);
+    data = std::make_unique<ResolverData>();
+    data->enclosing = std::move(enclosing);
+    data->scopeDepth = 0;
+    data->localOffset = 1;
+}
+
+std::vector<UpValueData> Resolver::endFunction() {
+    std::vector<UpValueData> upValues = std::move(data->upValues);
+    data = std::move(data->enclosing);
+    return upValues;
+}
+
+void Resolver::beginScope() {
+    data->scopeDepth++;
+}
+
+void Resolver::endScope() {
+    while (data->locals.size() && data->locals.back().depth >= data->scopeDepth) {
+        data->locals.pop_back();
+    }
+
+    data->scopeDepth--;
+}
+
+void Resolver::errorAt(SourceView view, std::string msg, std::string note) {
+    if (hadError) return;
+    hadError = true;
+    error = Error{view, "CompileError", msg, note, path};
+}
+
+void Resolver::addLocal(std::string name, SourceView view, bool constant) {
+    for (auto& local : data->locals) {
+        if (local.name == name && local.depth == data->scopeDepth) {
+            errorAt(view, formatStr("Already a local called '%s'", name));
+            return;
+        }
+    }
+
+    if (data->locals.size() > UINT16_MAX) {
+        errorAt(view, "Too many locals in scope");
+        return;
+    }
+
+    data->locals.push_back(Local{name, data->scopeDepth, constant});
+}
+
+int Resolver::addUpValue(std::unique_ptr<ResolverData>& data, u16 index, bool isLocal, SourceView view) {
+    for (int i = 0; i < (signed)data->upValues.size(); i++) {
+        auto& upValue = data->upValues[i];
+        if (upValue.index == index && upValue.isLocal == isLocal) {
+            return i;
+        }
+    }
+
+    int count = data->upValues.size();
+    if (count > UINT16_MAX) {
+        errorAt(view, "Too many captured locals in scope");
+        return -1;
+    }
+
+    data->upValues.push_back(UpValueData{index, isLocal});
+    return count;
+}
+
+int Resolver::findLocal(std::unique_ptr<ResolverData>& data, std::string& name) {
+    for (int index = (signed)data->locals.size() - 1; index >= 0; index--) {
+        if (data->locals[index].name == name) {
+            return index + data->localOffset;
+        }
+    }
+
+    return -1;
+}
+
+int Resolver::findUpValue(std::unique_ptr<ResolverData>& data, std::string& name, SourceView view) {
+    if (data->enclosing == nullptr) {
+        return -1;
+    }
+
+    int local = findLocal(data->enclosing, name);
+    if (local != -1) {
+        return addUpValue(data, local, true, view);
+    }
+
+    int upValue = findUpValue(data->enclosing, name, view);
+    if (upValue != -1) {
+        return addUpValue(data, upValue, false, view);
+    }
+
+    return -1;
+}
+
+void Resolver::addNumber(double value) {
+    // Adding constants in a fixed order keeps the pool the same when bodies are compiled in parallel
+    if (resolution->constants) {
+        resolution->constants->addNumber(value);
+    }
+}
+
+void Resolver::addName(const std::string& value) {
+    if (resolution->constants) {
+        resolution->constants->addName(value);
+    }
+}
+
+void Resolver::declare(std::string name, SourceView view, bool constant) {
+    if (data->scopeDepth == 0) {
+        auto found = resolution->constantGlobals.find(name);
+        if (found != resolution->constantGlobals.end() && found->second != view.index) {
+            errorAt(view, formatStr("Already a constant called '%s'", name));
+        } else if (constant) {
+            resolution->constantGlobals.emplace(name, view.index);
+        }
+
+        addName(name);
+        return;
+    }
+
+    addLocal(name, view, constant);
+}
+
+void Resolver::identifier(Identifier& id) {
+    int local = findLocal(data, id.name);
+    if (local != -1) {
+        resolution->variables[&id] = Variable{Variable::Local, local};
+        return;
+    }
+
+    int upValue = findUpValue(data, id.name, id.view);
+    if (upValue != -1) {
+        resolution->variables[&id] = Variable{Variable::UpValue, upValue};
+        return;
+    }
+
+    resolution->variables[&id] = Variable{Variable::Global, 0};
+    addName(id.name);
+}
+
+bool Resolver::isConstant(std::string& name) {
+    for (ResolverData* function = data.get(); function; function = function->enclosing.get()) {
+        for (int index = (signed)function->locals.size() - 1; index >= 0; index--) {
+            if (function->locals[index].name == name) {
+                return function->locals[index].constant;
+            }
+        }
+    }
+
+    return resolution->constantGlobals.count(name);
+}
+
+void Resolver::body(std::vector<Stmt>& stmts) {
+    for (Stmt& stmt : stmts) {
+        switch (stmt.which()) {
+            case Stmt::which<Ptr<ExprStmt>>(): {
+                expression(stmt.get<Ptr<ExprStmt>>()->expr);
+                break;
+            }
+
+            case Stmt::which<Ptr<ReturnStmt>>(): {
+                expression(stmt.get<Ptr<ReturnStmt>>()->value);
+                break;
+            }
+
+            case Stmt::which<Ptr<PrintStmt>>(): {
+                auto& print = stmt.get<Ptr<PrintStmt>>();
+                for (int i = (signed)print->exprs.size() - 1; i >= 0; i--) {
+                    expression(print->exprs[i]);
+                }
+                break;
+            }
+
+            case Stmt::which<Ptr<IfStmt>>(): {
+                auto& ifStmt = stmt.get<Ptr<IfStmt>>();
+                expression(ifStmt->condition);
+                body(ifStmt->body);
+                body(ifStmt->orelse);
+                break;
+            }
+
+            case Stmt::which<Ptr<LoopBlock>>(): {
+                beginScope();
+                body(stmt.get<Ptr<LoopBlock>>()->body);
+                endScope();
+                break;
+            }
+
+            case Stmt::which<Ptr<WhileLoop>>(): {
+                auto& whileLoop = stmt.get<Ptr<WhileLoop>>();
+                beginScope();
+                expression(whileLoop->condition);
+                body(whileLoop->body);
+                endScope();
+                break;
+            }
+
+            case Stmt::which<Ptr<ForLoop>>(): {
+                forLoop(*stmt.get<Ptr<ForLoop>>());
+                break;
+            }
+
+            case Stmt::which<Ptr<TypeDeclaration>>(): {
+                typeDeclaration(*stmt.get<Ptr<TypeDeclaration>>());
+                break;
+            }
+
+            case Stmt::which<Ptr<FuncDeclaration>>(): {
+                funcDeclaration(*stmt.get<Ptr<FuncDeclaration>>());
+                break;
+            }
+
+            case Stmt::which<Ptr<VarDeclaration>>(): {
+                auto& var = stmt.get<Ptr<VarDeclaration>>();
+                if (!var->expr.is<Empty>()) {
+                    expression(var->expr);
+                }
+                declare(var->target.name, var->target.view, var->constant);
+                break;
+            }
+
+            case Stmt::which<Ptr<BlockStmt>>(): {
+                beginScope();
+                body(stmt.get<Ptr<BlockStmt>>()->body);
+                endScope();
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+void Resolver::forLoop(ForLoop& stmt) {
+    beginScope();
+
+    // The loop's state lives in locals below the target, they can't be named from the body
+    if (stmt.range) {
+        for (auto& arg : stmt.iterator.get<Ptr<CallExpr>>()->args) {
+            expression(arg);
+        }
+        addLocal(" counter", stmt.view);
+        addLocal(" end", stmt.view);
+        addLocal(" step", stmt.view);
+    } else {
+        expression(stmt.iterator);
+        addLocal(" iterable", stmt.view);
+        addLocal(" state", stmt.view);
+    }
+
+    addLocal(stmt.target.name, stmt.target.view);
+    identifier(stmt.target);
+
+    beginScope();
+    body(stmt.body);
+    endScope();
+    endScope();
+}
+
+void Resolver::typeDeclaration(TypeDeclaration& stmt) {
+    for (auto& parent : stmt.parents) {
+        identifier(parent);
+    }
+
+    std::unordered_set<std::string> names;
+    for (auto& method : stmt.methods) {
+        FuncDeclaration& decl = *method.get<Ptr<FuncDeclaration>>();
+        if (!names.insert(decl.name.name).second) {
+            errorAt(decl.name.view, formatStr("Already a method called '%s'", decl.name.name));
+        }
+
+        methodDeclaration(decl);
+    }
+
+    declare(stmt.name.name, stmt.name.view);
+}
+
+void Resolver::methodDeclaration(FuncDeclaration& stmt) {
+    resolution->functionCount++;
+
+    // The instance takes the slot that holds the function in plain calls
+    newFunction();
+    data->localOffset = 0;
+    beginScope();
+    addLocal("self", stmt.name.view, true);
+
+    if (stmt.args.size() > UINT8_MAX) {
+        SourceView view = stmt.args[UINT8_MAX].view | stmt.args.back().view;
+        errorAt(view, formatStr("Too many arguments in method declaration (max: %d, you have %d)", UINT8_MAX, stmt.args.size()));
+    }
+
+    for (auto& arg : stmt.args) {
+        addLocal(arg.name, arg.view);
+    }
+
+    body(stmt.body);
+    endScope();
+
+    resolution->upValues[&stmt] = endFunction();
+    addName(stmt.name.name);
+}
+
+void Resolver::funcDeclaration(FuncDeclaration& stmt) {
+    resolution->functionCount++;
+
+    // Lazily compiled functions are resolved on their own once they are first called
+    if (lazy && data->enclosing == nullptr && data->scopeDepth == 0) {
+        resolution->upValues[&stmt] = {};
+        return;
+    }
+
+    newFunction();
+    beginScope();
+
+    if (stmt.args.size() > UINT8_MAX) {
+        SourceView view = stmt.args[UINT8_MAX].view | stmt.args.back().view;
+        errorAt(view, formatStr("Too many arguments in function declaration (max: %d, you have %d)", UINT8_MAX, stmt.args.size()));
+    }
+
+    for (auto& arg : stmt.args) {
+        addLocal(arg.name, arg.view);
+    }
+
+    body(stmt.body);
+    endScope();
+
+    resolution->upValues[&stmt] = endFunction();
+    declare(stmt.name.name, stmt.name.view);
+}
+
+void Resolver::expression(Expr& expr) {
+    switch (expr.which()) {
+        case Expr::which<NumLiteral>(): {
+            double value = expr.get<NumLiteral>().value;
+            if (!fitsInByte(value)) {
+                addNumber(value);
+            }
+            break;
+        }
+
+        case Expr::which<StrLiteral>(): {
+            addName(expr.get<StrLiteral>().value);
+            break;
+        }
+
+        case Expr::which<Identifier>(): {
+            identifier(expr.get<Identifier>());
+            break;
+        }
+
+        case Expr::which<Ptr<AssignmentExpr>>(): {
+            auto& assignment = expr.get<Ptr<AssignmentExpr>>();
+            expression(assignment->expr);
+
+            if (assignment->target.is<Identifier>()) {
+                Identifier& target = assignment->target.get<Identifier>();
+                if (isConstant(target.name)) {
+                    errorAt(target.view, formatStr("Cannot assign to constant '%s'", target.name));
+                }
+                identifier(target);
+            } else if (assignment->target.is<Ptr<PropertyExpr>>()) {
+                auto& prop = assignment->target.get<Ptr<PropertyExpr>>();
+                expression(prop->expr);
+                addName(prop->prop.name);
+            } else if (assignment->target.is<Ptr<IndexExpr>>()) {
+                auto& index = assignment->target.get<Ptr<IndexExpr>>();
+                expression(index->expr);
+                expression(index->index);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<BinaryExpr>>(): {
+            auto& binaryExpr = expr.get<Ptr<BinaryExpr>>();
+            expression(binaryExpr->left);
+            expression(binaryExpr->right);
+            break;
+        }
+
+        case Expr::which<Ptr<UnaryExpr>>(): {
+            expression(expr.get<Ptr<UnaryExpr>>()->expr);
+            break;
+        }
+
+        case Expr::which<Ptr<CallExpr>>(): {
+            auto& call = expr.get<Ptr<CallExpr>>();
+            for (auto& arg : call->args) {
+                expression(arg);
+            }
+            expression(call->target);
+            break;
+        }
+
+        case Expr::which<Ptr<PropertyExpr>>(): {
+            auto& prop = expr.get<Ptr<PropertyExpr>>();
+            expression(prop->expr);
+            addName(prop->prop.name);
+            break;
+        }
+
+        case Expr::which<Ptr<ListExpr>>(): {
+            for (auto& item : expr.get<Ptr<ListExpr>>()->items) {
+                expression(item);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<DictExpr>>(): {
+            auto& dict = expr.get<Ptr<DictExpr>>();
+            for (int i = 0; i < (signed)dict->keys.size(); i++) {
+                expression(dict->keys[i]);
+                expression(dict->values[i]);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<IndexExpr>>(): {
+            auto& index = expr.get<Ptr<IndexExpr>>();
+            expression(index->expr);
+            expression(index->index);
+            break;
+        }
+
+        case Expr::which<Ptr<SliceExpr>>(): {
+            auto& slice = expr.get<Ptr<SliceExpr>>();
+            expression(slice->expr);
+            expression(slice->start);
+            expression(slice->end);
+            break;
+        }
+
+        case Expr::which<Ptr<FormatExpr>>(): {
+            for (auto& part : expr.get<Ptr<FormatExpr>>()->parts) {
+                expression(part);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,826 @@
+#include "compiler/singlepass.h"
+#include <algorithm>
+
+using Marker = std::pair<int, SourceView>;
+
+static bool markerBefore(const Marker& marker, int where) {
+    return marker.first < where;
+}
+
+Chunk SinglePassCompiler::compile() {
+    hadError = false;
+    context = std::make_shared<CompileContext>();
+    context->options = options;
+    context->resolution.constants = std::make_shared<ConstantPool>();
+
+    newChunk();
+    chunkData->name = path;
+    chunkData->global = true;
+
+    advance();
+    while (!isFinished()) {
+        statement();
+    }
+
+    emitByte(OpExit, 0);
+    return endChunk();
+}
+
+void SinglePassCompiler::advance() {
+    if (hadError) return;
+
+    prev = cur;
+    cur = scanner.nextToken();
+
+    if (cur.type == TokenType::Error) {
+        unsupported();
+    }
+}
+
+void SinglePassCompiler::consume(TokenType type) {
+    if (check(type)) {
+        advance();
+        return;
+    }
+
+    unsupported();
+}
+
+bool SinglePassCompiler::isFinished() {
+    return check(TokenType::EndOfFile) || hadError;
+}
+
+bool SinglePassCompiler::check(TokenType type) {
+    return cur.type == type;
+}
+
+bool SinglePassCompiler::match(TokenType type) {
+    if (isFinished()) return false;
+    if (!check(type)) return false;
+
+    advance();
+    return true;
+}
+
+template <typename... Args>
+bool SinglePassCompiler::match(TokenType type, Args... args) {
+    return match(type) || match(args...);
+}
+
+void SinglePassCompiler::unsupported() {
+    // The ast pipeline runs again and reports the actual error, if there is one
+    hadError = true;
+}
+
+void SinglePassCompiler::beginFunction() {
+    enclosing.push_back(EnclosingFunction{std::move(chunkData), std::move(upValues)});
+    upValues.clear();
+    newChunk();
+}
+
+std::vector<UpValueData> SinglePassCompiler::endFunction(Prototype& prot) {
+    std::vector<UpValueData> captured = std::move(upValues);
+    prot.slots = chunkData->slots + 1;
+    prot.chunk = endChunk();
+    prot.upValues = captured.size();
+
+    chunkData = std::move(enclosing.back().chunkData);
+    upValues = std::move(enclosing.back().upValues);
+    enclosing.pop_back();
+    return captured;
+}
+
+int SinglePassCompiler::offset() {
+    return (signed)getChunk()->bytecode.size();
+}
+
+void SinglePassCompiler::insertMarker(int where, SourceView view) {
+    auto& markers = getChunk()->markers;
+    markers.insert(std::lower_bound(markers.begin(), markers.end(), where, markerBefore), {where, view});
+}
+
+void SinglePassCompiler::moveToEnd(int from, int to) {
+    auto& bytecode = getChunk()->bytecode;
+    auto& markers = getChunk()->markers;
+    int end = offset();
+
+    std::rotate(bytecode.begin() + from, bytecode.begin() + to, bytecode.end());
+
+    auto first = std::lower_bound(markers.begin(), markers.end(), from, markerBefore);
+    auto middle = std::lower_bound(first, markers.end(), to, markerBefore);
+    for (auto marker = first; marker != markers.end(); marker++) {
+        marker->first += marker < middle ? end - to : from - to;
+    }
+
+    std::rotate(first, middle, markers.end());
+}
+
+void SinglePassCompiler::copyToEnd(int from, int to) {
+    auto& bytecode = getChunk()->bytecode;
+    auto& markers = getChunk()->markers;
+    int end = offset();
+
+    auto first = std::lower_bound(markers.begin(), markers.end(), from, markerBefore);
+    auto last = std::lower_bound(first, markers.end(), to, markerBefore);
+    std::vector<Marker> copied(first, last);
+    for (auto& marker : copied) {
+        markers.push_back({marker.first - from + end, marker.second});
+    }
+
+    bytecode.insert(bytecode.end(), bytecode.begin() + from, bytecode.begin() + to);
+}
+
+void SinglePassCompiler::truncate(int where) {
+    auto& markers = getChunk()->markers;
+    markers.erase(std::lower_bound(markers.begin(), markers.end(), where, markerBefore), markers.end());
+    getChunk()->bytecode.resize(where);
+}
+
+void SinglePassCompiler::declareChecked(Token& name) {
+    if (chunkData->scopeDepth > 0) {
+        for (auto& local : chunkData->locals) {
+            if (local.name == name.value && local.depth == chunkData->scopeDepth) {
+                unsupported();
+                return;
+            }
+        }
+
+        if (chunkData->locals.size() > UINT16_MAX) {
+            unsupported();
+            return;
+        }
+    }
+
+    declare(name.value, name.view);
+}
+
+int SinglePassCompiler::findLocal(ChunkData& data, std::string& name) {
+    for (int index = (signed)data.locals.size() - 1; index >= 0; index--) {
+        if (data.locals[index].name == name) {
+            return index + (data.global ? 0 : 1);
+        }
+    }
+
+    return -1;
+}
+
+int SinglePassCompiler::findUpValue(int depth, std::string& name) {
+    if (depth >= (signed)enclosing.size()) {
+        return -1;
+    }
+
+    int local = findLocal(*enclosing[enclosing.size() - 1 - depth].chunkData, name);
+    if (local != -1) {
+        return addUpValue(depth, local, true);
+    }
+
+    int upValue = findUpValue(depth + 1, name);
+    if (upValue != -1) {
+        return addUpValue(depth, upValue, false);
+    }
+
+    return -1;
+}
+
+int SinglePassCompiler::addUpValue(int depth, u16 index, bool isLocal) {
+    auto& list = depth == 0 ? upValues : enclosing[enclosing.size() - depth].upValues;
+    for (int i = 0; i < (signed)list.size(); i++) {
+        if (list[i].index == index && list[i].isLocal == isLocal) {
+            return i;
+        }
+    }
+
+    int count = list.size();
+    if (count > UINT16_MAX) {
+        unsupported();
+        return -1;
+    }
+
+    list.push_back(UpValueData{index, isLocal});
+    return count;
+}
+
+void SinglePassCompiler::variable(Token& name, bool get) {
+    int local = findLocal(*chunkData, name.value);
+    if (local != -1) {
+        emitInstruction(get ? OpGetLocal : OpSetLocal, local);
+        return;
+    }
+
+    int upValue = findUpValue(0, name.value);
+    if (upValue != -1) {
+        emitInstruction(get ? OpGetUpValue : OpSetUpValue, upValue);
+        return;
+    }
+
+    int index = makeNameConstant(name.value, name.view);
+    marker(name.view);
+    emitInstruction(get ? OpGetGlobal : OpSetGlobal, index);
+}
+
+void SinglePassCompiler::statement() {
+    SourceView view = cur.view;
+
+    switch (cur.type) {
+        case TokenType::Print:
+            printStmt();
+            break;
+
+        case TokenType::If:
+            ifStmt();
+            break;
+
+        case TokenType::Loop:
+            loopBlock();
+            break;
+
+        case TokenType::While:
+            whileLoop();
+            break;
+
+        case TokenType::Return:
+            returnStmt();
+            break;
+
+        case TokenType::Func:
+            funcDeclaration();
+            break;
+
+        case TokenType::Var:
+            varDeclaration();
+            break;
+
+        case TokenType::LeftBrace:
+            advance();
+            beginScope();
+            block();
+            endScope();
+            break;
+
+        case TokenType::Break: {
+            advance();
+            consume(TokenType::Semicolon);
+            BreakStmt stmt = BreakStmt{view};
+            breakStmt(stmt);
+            break;
+        }
+
+        case TokenType::Continue: {
+            advance();
+            consume(TokenType::Semicolon);
+            ContinueStmt stmt = ContinueStmt{view};
+            continueStmt(stmt);
+            break;
+        }
+
+        case TokenType::Exit: {
+            advance();
+            consume(TokenType::Number);
+            NumLiteral code = NumLiteral{prev.view, prev.value.front() == '.' ? std::stod("0." + prev.value) : std::stod(prev.value)};
+            ExitStmt stmt = ExitStmt{view | prev.view, code};
+            consume(TokenType::Semicolon);
+            exitStmt(stmt);
+            break;
+        }
+
+        case TokenType::For:
+        case TokenType::Type:
+        case TokenType::Const:
+        case TokenType::EndOfFile:
+        case TokenType::Error:
+            unsupported();
+            break;
+
+        default:
+            expression();
+            consume(TokenType::Semicolon);
+            emitByte(OpPop);
+            break;
+    }
+}
+
+void SinglePassCompiler::block() {
+    while (!check(TokenType::RightBrace) && !isFinished()) {
+        statement();
+    }
+
+    consume(TokenType::RightBrace);
+}
+
+void SinglePassCompiler::printStmt() {
+    advance();
+
+    std::vector<int> starts;
+    while (!isFinished()) {
+        starts.push_back(offset());
+        expression();
+
+        if (!match(TokenType::Comma))
+            break;
+    }
+    starts.push_back(offset());
+
+    // Values are printed from the top of the stack, so the last one has to be evaluated first
+    for (int i = (signed)starts.size() - 3; i >= 0; i--) {
+        moveToEnd(starts[i], starts[i + 1]);
+    }
+
+    consume(TokenType::Semicolon);
+    emitByte(OpPrint, starts.size() - 1);
+}
+
+void SinglePassCompiler::ifStmt() {
+    advance();
+    expression();
+    consume(TokenType::LeftBrace);
+    int elseJump = emitJumpForwards(OpJumpPopIfFalse);
+    block();
+
+    if (!match(TokenType::Else)) {
+        patchJump(elseJump);
+        return;
+    }
+
+    if (check(TokenType::If)) {
+        int endJump = emitJumpForwards(OpJump);
+        patchJump(elseJump);
+        ifStmt();
+        patchJump(endJump);
+        return;
+    }
+
+    consume(TokenType::LeftBrace);
+    if (match(TokenType::RightBrace)) {
+        patchJump(elseJump);
+        return;
+    }
+
+    int endJump = emitJumpForwards(OpJump);
+    patchJump(elseJump);
+    block();
+    patchJump(endJump);
+}
+
+void SinglePassCompiler::loopBlock() {
+    advance();
+    consume(TokenType::LeftBrace);
+    int start = offset();
+    beginLoop(start);
+    beginScope();
+    block();
+    endScope();
+    emitJumpBackwards(OpJumpBack, start);
+    endLoop();
+}
+
+void SinglePassCompiler::whileLoop() {
+    advance();
+    int start = offset();
+    beginLoop(start);
+    expression();
+    consume(TokenType::LeftBrace);
+    int endJump = emitJumpForwards(OpJumpPopIfFalse);
+    beginScope();
+    block();
+    endScope();
+    emitJumpBackwards(OpJumpBack, start);
+    patchJump(endJump);
+    endLoop();
+}
+
+void SinglePassCompiler::returnStmt() {
+    advance();
+    if (chunkData->global) {
+        unsupported();
+        return;
+    }
+
+    if (match(TokenType::Semicolon)) {
+        emitByte(OpNone);
+    } else {
+        expression();
+        consume(TokenType::Semicolon);
+    }
+
+    emitByte(OpReturn);
+}
+
+void SinglePassCompiler::funcDeclaration() {
+    advance();
+    if (!match(TokenType::Identifier)) {
+        unsupported();
+        return;
+    }
+    Token name = prev;
+    consume(TokenType::LeftParen);
+
+    std::vector<Token> args;
+    while (!isFinished() && !check(TokenType::RightParen)) {
+        if (!match(TokenType::Identifier)) {
+            unsupported();
+            return;
+        }
+        args.push_back(prev);
+
+        if (!match(TokenType::Comma))
+            break;
+    }
+
+    consume(TokenType::RightParen);
+    consume(TokenType::LeftBrace);
+
+    if (args.size() > UINT8_MAX) {
+        unsupported();
+        return;
+    }
+
+    Shared<Prototype> prot = std::make_shared<Prototype>();
+    prot->name = name.value;
+    prot->argc = args.size();
+
+    // The body has to be compiled first, the enclosing chunk needs to know what it captures
+    beginFunction();
+    chunkData->name = name.value;
+    beginScope();
+    for (auto& arg : args) {
+        declareChecked(arg);
+    }
+
+    block();
+    endScope();
+    emitByte(OpNone, OpReturn);
+    std::vector<UpValueData> captured = endFunction(*prot);
+
+    emitFunction(getChunk()->prototypes.size(), captured);
+    declareChecked(name);
+    getChunk()->prototypes.push_back(prot);
+}
+
+void SinglePassCompiler::varDeclaration() {
+    advance();
+    if (!match(TokenType::Identifier)) {
+        unsupported();
+        return;
+    }
+    Token name = prev;
+
+    if (match(TokenType::Equal)) {
+        expression();
+    } else {
+        emitByte(OpNone);
+    }
+
+    consume(TokenType::Semicolon);
+    declareChecked(name);
+}
+
+EmittedExpr SinglePassCompiler::expression() {
+    EmittedExpr target = _or();
+
+    if (!match(TokenType::Equal, TokenType::PlusEqual, TokenType::MinusEqual, TokenType::SlashEqual, TokenType::AsteriskEqual, TokenType::CarretEqual)) {
+        return target;
+    }
+
+    // The target was already emitted as a get, it gets replaced or reused depending on the operator
+    Token op = prev;
+    switch (target.kind) {
+        case EmittedExpr::Name:
+            if (op.type == TokenType::Equal) {
+                truncate(target.start);
+                _or();
+            } else {
+                _or();
+                binary(op, target.start);
+            }
+
+            variable(target.token, false);
+            break;
+
+        case EmittedExpr::Property:
+            if (op.type == TokenType::Equal) {
+                truncate(target.end);
+                _or();
+                moveToEnd(target.start, target.end);
+            } else {
+                _or();
+                marker(op.view);
+                emitOperator(op.type);
+                copyToEnd(target.start, target.end);
+                insertMarker(target.start, op.view);
+            }
+
+            marker(target.token.view);
+            emitProperty(OpSetProperty, makeNameConstant(target.token.value, target.token.view));
+            break;
+
+        default:
+            unsupported();
+            break;
+    }
+
+    // Chained assignments don't assign anything in the ast compiler, leave them to it
+    if (check(TokenType::Equal) || check(TokenType::PlusEqual) || check(TokenType::MinusEqual) || check(TokenType::SlashEqual) || check(TokenType::AsteriskEqual) || check(TokenType::CarretEqual)) {
+        unsupported();
+    }
+
+    return EmittedExpr{EmittedExpr::Other, target.start};
+}
+
+EmittedExpr SinglePassCompiler::_or() {
+    EmittedExpr expr = _and();
+
+    while (match(TokenType::Or)) {
+        insertMarker(expr.start, prev.view);
+        int jump = emitJumpForwards(OpJumpIfTrue);
+        emitByte(OpPop);
+        _and();
+        patchJump(jump);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::_and() {
+    EmittedExpr expr = equality();
+
+    while (match(TokenType::And)) {
+        insertMarker(expr.start, prev.view);
+        int jump = emitJumpForwards(OpJumpIfFalse);
+        emitByte(OpPop);
+        equality();
+        patchJump(jump);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::equality() {
+    EmittedExpr expr = comparison();
+
+    while (match(TokenType::EqualEqual, TokenType::BangEqual)) {
+        Token op = prev;
+        comparison();
+        binary(op, expr.start);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::comparison() {
+    EmittedExpr expr = term();
+
+    while (match(TokenType::Greater, TokenType::Less, TokenType::LessEqual, TokenType::GreaterEqual)) {
+        Token op = prev;
+        term();
+        binary(op, expr.start);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::term() {
+    EmittedExpr expr = factor();
+
+    while (match(TokenType::Plus, TokenType::Minus, TokenType::Percent)) {
+        Token op = prev;
+        factor();
+        binary(op, expr.start);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::factor() {
+    EmittedExpr expr = exponent();
+
+    while (match(TokenType::Asterisk, TokenType::Slash)) {
+        Token op = prev;
+        exponent();
+        binary(op, expr.start);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::exponent() {
+    EmittedExpr expr = unary();
+
+    while (match(TokenType::Carret)) {
+        Token op = prev;
+        unary();
+        binary(op, expr.start);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::unary() {
+    int start = offset();
+
+    if (match(TokenType::Minus, TokenType::Plus)) {
+        bool isNegative = true;
+        while (match(TokenType::Minus, TokenType::Plus)) {
+            if (prev.type == TokenType::Minus)
+                isNegative = !isNegative;
+        }
+        if (isNegative) {
+            Token op = prev;
+            EmittedExpr operand = post();
+
+            // Negative number literals are folded into a single constant like the ast compiler does
+            if (operand.kind == EmittedExpr::Literal && operand.token.type == TokenType::Number) {
+                truncate(start);
+                Token& num = operand.token;
+                Expr literal = NumLiteral{op.view | num.view, -(num.value.front() == '.' ? std::stod("0." + num.value) : std::stod(num.value))};
+                Compiler::expression(literal);
+                return EmittedExpr{EmittedExpr::Other, start};
+            }
+
+            marker(op.view);
+            emitByte(OpNegate);
+            return EmittedExpr{EmittedExpr::Other, start};
+        }
+    } else if (match(TokenType::Bang)) {
+        bool isNegate = true;
+        while (match(TokenType::Minus)) isNegate = !isNegate;
+
+        if (isNegate) {
+            Token op = prev;
+            post();
+            marker(op.view);
+            emitByte(OpNot);
+            return EmittedExpr{EmittedExpr::Other, start};
+        }
+    }
+
+    return post();
+}
+
+EmittedExpr SinglePassCompiler::post() {
+    SourceView view = cur.view;
+    EmittedExpr expr = primary();
+
+    while (match(TokenType::Dot, TokenType::LeftParen)) {
+        if (prev.type == TokenType::Dot) {
+            consume(TokenType::Identifier);
+            Token prop = prev;
+            int end = offset();
+            int index = makeNameConstant(prop.value, prop.view);
+            marker(prop.view);
+            emitProperty(OpGetProperty, index);
+            expr = EmittedExpr{EmittedExpr::Property, expr.start, end, prop};
+            continue;
+        }
+
+        // Methods are looked up and called in one go, without binding them first
+        bool invoke = expr.kind == EmittedExpr::Property;
+        if (invoke) {
+            truncate(expr.end);
+        }
+
+        int args = offset();
+        int argc = 0;
+        emitByte(OpNone);
+
+        if (!check(TokenType::RightParen)) {
+            while (!isFinished()) {
+                expression();
+                argc++;
+
+                if (!match(TokenType::Comma))
+                    break;
+            }
+        }
+
+        consume(TokenType::RightParen);
+        if (argc > UINT8_MAX) {
+            unsupported();
+        }
+
+        // The placeholder and arguments go below the target
+        moveToEnd(expr.start, args);
+
+        SourceView target = expr.kind == EmittedExpr::Literal || expr.kind == EmittedExpr::Name ? expr.token.view : SourceView{};
+        SourceView call = view | prev.view;
+        if (invoke) {
+            marker(expr.token.view);
+            emitProperty(OpInvoke, makeNameConstant(expr.token.value, expr.token.view));
+        } else {
+            marker(target);
+            emitByte(OpCall);
+        }
+        marker(call);
+        emitByte(argc);
+        expr = EmittedExpr{EmittedExpr::Other, expr.start};
+    }
+
+    return expr;
+}
+
+EmittedExpr SinglePassCompiler::primary() {
+    int start = offset();
+    advance();
+    Token token = prev;
+
+    Expr literal;
+    switch (token.type) {
+        case TokenType::True:
+            literal = BoolLiteral{token.view, true};
+            break;
+        case TokenType::False:
+            literal = BoolLiteral{token.view, false};
+            break;
+        case TokenType::None:
+            literal = NoneLiteral{token.view};
+            break;
+
+        case TokenType::Number:
+            literal = NumLiteral{token.view, token.value.front() == '.' ? std::stod("0." + token.value) : std::stod(token.value)};
+            break;
+
+        case TokenType::String:
+            literal = StrLiteral{token.view, std::string(token.value.data() + 1, token.value.length() - 2)};
+            break;
+
+        case TokenType::Identifier:
+            variable(token, true);
+            return EmittedExpr{EmittedExpr::Name, start, 0, token};
+
+        case TokenType::LeftParen: {
+            EmittedExpr expr = expression();
+            consume(TokenType::RightParen);
+            return expr;
+        }
+
+        default:
+            unsupported();
+            return EmittedExpr{EmittedExpr::Other, start};
+    }
+
+    // Literals are emitted exactly like the ast compiler does
+    Compiler::expression(literal);
+    return EmittedExpr{EmittedExpr::Literal, start, 0, token};
+}
+
+void SinglePassCompiler::binary(Token& op, int start) {
+    // The ast compiler marks binary operations before their left operand and again before the operation
+    insertMarker(start, op.view);
+    marker(op.view);
+    emitOperator(op.type);
+}
+
+void SinglePassCompiler::emitOperator(TokenType type) {
+    switch (type) {
+        case TokenType::Plus:
+        case TokenType::PlusEqual:
+            emitByte(OpAdd);
+            break;
+        case TokenType::Minus:
+        case TokenType::MinusEqual:
+            emitByte(OpSubtract);
+            break;
+        case TokenType::Percent:
+            emitByte(OpModulous);
+            break;
+        case TokenType::Asterisk:
+        case TokenType::AsteriskEqual:
+            emitByte(OpMultiply);
+            break;
+        case TokenType::Slash:
+        case TokenType::SlashEqual:
+            emitByte(OpDivide);
+            break;
+        case TokenType::Carret:
+        case TokenType::CarretEqual:
+            emitByte(OpExponent);
+            break;
+        case TokenType::Greater:
+            emitByte(OpGreater);
+            break;
+        case TokenType::Less:
+            emitByte(OpLess);
+            break;
+        case TokenType::GreaterEqual:
+            emitByte(OpGreaterThanOrEq);
+            break;
+        case TokenType::LessEqual:
+            emitByte(OpLessThanOrEq);
+            break;
+        case TokenType::EqualEqual:
+            emitByte(OpEqual);
+            break;
+        case TokenType::BangEqual:
+            emitByte(OpEqual);
+            emitByte(OpNot);
+            break;
+        default:
+            break;
+    }
+}
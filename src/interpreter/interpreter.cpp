@@ -1,8 +1,10 @@
 #include "interpreter/interpreter.h"
+
+#include <algorithm>
 #include "builtins.h"
 #include "print.h"
 
-Interpreter::Interpreter(State& state) : state(state) {
+Interpreter::Interpreter(State& state) : state(state), output(state.output) {
     stack.reserve(stack_max);
     frames.reserve(frames_max);
 }
@@ -10,8 +12,12 @@ Interpreter::Interpreter(State& state) : state(state) {
 Result Interpreter::interpret(Shared<Module> mod, Chunk& chunk) {
     newFrame(mod, chunk, stack.data(), nullptr);
     hadError = false;
+    wide = false;
     openUpValues = nullptr;
-    return run();
+
+    Result result = run();
+    output.flush();
+    return result;
 }
 
 Result Interpreter::run() {
@@ -26,7 +32,11 @@ Result Interpreter::run() {
             }
 
             case OpReturn: {
+                // The result replaces the call's slot and everything above it is dropped
+                Value result = pop();
                 closeUpValues(frame->sp);
+                stack.resize(frame->sp - stack.data());
+                stack.push_back(result);
                 frames.pop_back();
                 frame = getFrame();
                 break;
@@ -74,7 +84,7 @@ Result Interpreter::run() {
                 if (a.is<Number>() && b.is<Number>()) {
                     push(a.get<Number>() + b.get<Number>());
                 } else if (a.is<String>() && b.is<String>()) {
-                    push(a.get<String>() + b.get<String>());
+                    push(a.get<String>().concat(b.get<String>()));
                 } else {
                     errorAt("Can only add numbers or strings");
                     return Result{1};
@@ -140,6 +150,19 @@ Result Interpreter::run() {
                 break;
             }
 
+            case OpExponent: {
+                Value b = pop();
+                Value a = pop();
+
+                if (!a.is<Number>() || !b.is<Number>()) {
+                    errorAt("Can only exponentiate numbers");
+                    return Result{1};
+                }
+
+                push(std::pow(a.get<Number>(), b.get<Number>()));
+                break;
+            }
+
             case OpEqual: {
                 Value b = pop();
                 Value a = pop();
@@ -147,6 +170,13 @@ Result Interpreter::run() {
                 break;
             }
 
+            case OpNotEqual: {
+                Value b = pop();
+                Value a = pop();
+                push(!valuesEqual(a, b));
+                break;
+            }
+
             case OpGreater: {
                 Value b = pop();
                 Value a = pop();
@@ -216,15 +246,90 @@ Result Interpreter::run() {
                 break;
             }
 
+            // The compiler proved both operands are numbers, so these skip the type checks
+            case OpAddNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back().get_unchecked<Number>() += b;
+                break;
+            }
+
+            case OpSubtractNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back().get_unchecked<Number>() -= b;
+                break;
+            }
+
+            case OpMultiplyNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back().get_unchecked<Number>() *= b;
+                break;
+            }
+
+            case OpDivideNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                if (b == 0) {
+                    errorAt("Cannot divide by zero");
+                    return Result{1};
+                }
+
+                stack.pop_back();
+                stack.back().get_unchecked<Number>() /= b;
+                break;
+            }
+
+            case OpGreaterNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back() = stack.back().get_unchecked<Number>() > b;
+                break;
+            }
+
+            case OpLessNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back() = stack.back().get_unchecked<Number>() < b;
+                break;
+            }
+
+            case OpGreaterThanOrEqNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back() = stack.back().get_unchecked<Number>() >= b;
+                break;
+            }
+
+            case OpLessThanOrEqNumbers: {
+                Number b = stack.back().get_unchecked<Number>();
+                stack.pop_back();
+                stack.back() = stack.back().get_unchecked<Number>() <= b;
+                break;
+            }
+
+            case OpNegateNumber: {
+                Number& a = stack.back().get_unchecked<Number>();
+                a = -a;
+                break;
+            }
+
             case OpPrint: {
-                std::string output;
+                // Values go straight into the output buffer, separated and ended like the debug print
                 for (int count = readByte(); count > 0; count--) {
-                    output += getValueStr(pop());
-                    if (count > 1) {
-                        output += " ";
+                    Value value = pop();
+                    if (value.is<Number>()) {
+                        char buffer[number_chars_max];
+                        output.write(std::string_view(buffer, formatNumber(value.get<Number>(), buffer)));
+                    } else if (value.is<String>()) {
+                        output.write(value.get<String>().view());
+                    } else {
+                        output.write(getValueStr(value));
                     }
+
+                    output.write(" ");
                 }
-                print(output);
+                output.endLine();
                 break;
             }
 
@@ -234,7 +339,7 @@ Result Interpreter::run() {
             }
 
             case OpGetGlobal: {
-                String name = readNameConstant();
+                std::string name = readNameConstant();
                 auto value = frame->mod->globals.find(name);
 
                 if (value == frame->mod->globals.end()) {
@@ -247,7 +352,7 @@ Result Interpreter::run() {
             }
 
             case OpSetGlobal: {
-                String name = readNameConstant();
+                std::string name = readNameConstant();
                 auto value = frame->mod->globals.find(name);
 
                 if (value == frame->mod->globals.end()) {
@@ -260,75 +365,397 @@ Result Interpreter::run() {
             };
 
             case OpGetLocal: {
-                push(frame->sp[readByte()]);
+                push(frame->sp[readOperand()]);
                 break;
             }
 
             case OpSetLocal: {
-                frame->sp[readByte()] = peek(0);
+                frame->sp[readOperand()] = peek(0);
                 break;
             }
 
             case OpGetProperty: {
+                u16 name = readOperand();
+                InlineCache& cache = frame->chunk.caches[readOperand()];
+                Value& target = stack.back();
+
+                if (!target.is<Shared<Instance>>()) {
+                    errorAt(formatStr("Can't get properties of '%s'", getTypename(target.which())));
+                    return Result{1};
+                }
+
+                Shared<Instance> instance = target.get<Shared<Instance>>();
+                if (!findProperty(*instance, frame->chunk.constants->names[name], cache)) {
+                    return Result{1};
+                }
+
+                if (cache.method) {
+                    target = std::make_shared<BoundMethod>(BoundMethod{instance, instance->type->methods[cache.slot]});
+                } else {
+                    target = instance->fields[cache.slot];
+                }
+                break;
+            }
+
+            case OpInvoke: {
+                u16 name = readOperand();
+                InlineCache& cache = frame->chunk.caches[readOperand()];
+                Value& target = stack.back();
+
+                if (!target.is<Shared<Instance>>()) {
+                    errorAt(formatStr("Can't get properties of '%s'", getTypename(target.which())));
+                    return Result{1};
+                }
+
+                Shared<Instance> instance = target.get<Shared<Instance>>();
+                if (!findProperty(*instance, frame->chunk.constants->names[name], cache)) {
+                    return Result{1};
+                }
+
+                // Fields holding functions are called like normal
+                if (!cache.method) {
+                    target = instance->fields[cache.slot];
+                    if (!callValue(pop())) {
+                        return Result{1};
+                    }
+                    frame = getFrame();
+                    break;
+                }
+
+                // The receiver goes straight into the call's slot, so the method is never bound
+                Shared<Function> method = instance->type->methods[cache.slot];
+                stack.pop_back();
+                u8 argc = readByte();
+                stack[stack.size() - argc - 1] = std::move(instance);
+                if (!callFunction(method, argc)) {
+                    return Result{1};
+                }
+                frame = getFrame();
                 break;
             }
 
             case OpSetProperty: {
+                u16 name = readOperand();
+                InlineCache& cache = frame->chunk.caches[readOperand()];
+                Value target = pop();
+
+                if (!target.is<Shared<Instance>>()) {
+                    errorAt(formatStr("Can't set properties of '%s'", getTypename(target.which())));
+                    return Result{1};
+                }
+
+                Instance& instance = *target.get<Shared<Instance>>();
+                if (cache.shape == instance.shape && !cache.method) {
+                    if (cache.next) {
+                        instance.shape = cache.next;
+                        instance.fields.push_back(peek(0));
+                    } else {
+                        instance.fields[cache.slot] = peek(0);
+                    }
+                    break;
+                }
+
+                std::string& prop = frame->chunk.constants->names[name];
+                auto slot = instance.shape->slots.find(prop);
+                if (slot != instance.shape->slots.end()) {
+                    cache = InlineCache{instance.shape, nullptr, slot->second, false};
+                    instance.fields[slot->second] = peek(0);
+                    break;
+                }
+
+                if (instance.fields.size() == UINT16_MAX) {
+                    errorAt(formatStr("Too many fields on '%s'", instance.type->name));
+                    return Result{1};
+                }
+
+                Shared<Shape> next = instance.shape->transition(prop);
+                cache = InlineCache{instance.shape, next, (u16)instance.fields.size(), false};
+                instance.shape = next;
+                instance.fields.push_back(peek(0));
+                break;
+            }
+
+            case OpList: {
+                u8 count = readByte();
+                Shared<List> list = std::make_shared<List>();
+                list->numbers.reserve(count);
+
+                Value* items = stack.data() + stack.size() - count;
+                for (int i = 0; i < count; i++) {
+                    list->push(items[i]);
+                }
+
+                stack.resize(stack.size() - count);
+                push(list);
+                break;
+            }
+
+            case OpDict: {
+                u8 count = readByte();
+                Shared<Dict> dict = std::make_shared<Dict>();
+
+                Value* items = stack.data() + stack.size() - count * 2;
+                for (int i = 0; i < count; i++) {
+                    size_t hash;
+                    if (!hashKey(items[i * 2], hash)) {
+                        return Result{1};
+                    }
+
+                    dict->set(items[i * 2], hash, items[i * 2 + 1]);
+                }
+
+                stack.resize(stack.size() - count * 2);
+                push(dict);
+                break;
+            }
+
+            case OpGetIndex: {
+                Value index = pop();
+                Value& target = stack.back();
+                size_t i;
+
+                if (target.is<Shared<Dict>>()) {
+                    Shared<Dict> dict = target.get<Shared<Dict>>();
+                    size_t hash;
+                    if (!hashKey(index, hash)) {
+                        return Result{1};
+                    }
+
+                    Value* value = dict->find(index, hash);
+                    if (!value) {
+                        errorAt(formatStr("Key '%s' not found", getValueStr(index)));
+                        return Result{1};
+                    }
+
+                    target = *value;
+                } else if (target.is<Shared<List>>()) {
+                    Shared<List> list = target.get<Shared<List>>();
+                    if (!getIndex(index, list->size(), i)) {
+                        return Result{1};
+                    }
+
+                    target = list->boxed ? list->values[i] : Value(list->numbers[i]);
+                } else if (target.is<String>()) {
+                    String& str = target.get<String>();
+                    if (!getIndex(index, str.size(), i)) {
+                        return Result{1};
+                    }
+
+                    target = String(std::string(1, str[i]));
+                } else {
+                    errorAt(formatStr("Can't index into '%s'", getTypename(target.which())));
+                    return Result{1};
+                }
+                break;
+            }
+
+            case OpSetIndex: {
+                Value index = pop();
+                Value target = pop();
+                size_t i;
+
+                if (target.is<Shared<Dict>>()) {
+                    if (!hashKey(index, i)) {
+                        return Result{1};
+                    }
+
+                    target.get<Shared<Dict>>()->set(index, i, peek(0));
+                    break;
+                }
+
+                if (!target.is<Shared<List>>()) {
+                    errorAt(formatStr("Can't assign to an index of '%s'", getTypename(target.which())));
+                    return Result{1};
+                }
+
+                List& list = *target.get<Shared<List>>();
+                if (!getIndex(index, list.size(), i)) {
+                    return Result{1};
+                }
+
+                list.set(i, peek(0));
+                break;
+            }
+
+            case OpBuildString: {
+                u8 count = readByte();
+                Value* parts = stack.data() + stack.size() - count;
+
+                // Numbers are formatted on the stack once to measure and again to copy, only other
+                // values that aren't strings get converted into a string of their own
+                char buffer[number_chars_max];
+                std::vector<std::string> converted;
+                size_t length = 0;
+                for (int i = 0; i < count; i++) {
+                    if (parts[i].is<String>()) {
+                        length += parts[i].get<String>().size();
+                    } else if (parts[i].is<Number>()) {
+                        length += formatNumber(parts[i].get<Number>(), buffer);
+                    } else {
+                        converted.push_back(getValueStr(parts[i]));
+                        length += converted.back().size();
+                    }
+                }
+
+                std::string result(length, '\0');
+                char* out = result.data();
+                auto next = converted.begin();
+                for (int i = 0; i < count; i++) {
+                    if (parts[i].is<Number>()) {
+                        out = std::copy_n(buffer, formatNumber(parts[i].get<Number>(), buffer), out);
+                        continue;
+                    }
+
+                    std::string_view part = parts[i].is<String>() ? parts[i].get<String>().view() : std::string_view(*next++);
+                    out = std::copy(part.begin(), part.end(), out);
+                }
+
+                stack.resize(stack.size() - count);
+                push(String(std::move(result)));
+                break;
+            }
+
+            case OpSlice: {
+                Value end = pop();
+                Value start = pop();
+                Value& target = stack.back();
+                size_t from, to;
+
+                if (target.is<Shared<List>>()) {
+                    Shared<List> list = target.get<Shared<List>>();
+                    if (!getSliceBound(start, list->size(), 0, from) || !getSliceBound(end, list->size(), list->size(), to)) {
+                        return Result{1};
+                    }
+
+                    target = list->slice(from, to);
+                } else if (target.is<String>()) {
+                    String& str = target.get<String>();
+                    if (!getSliceBound(start, str.size(), 0, from) || !getSliceBound(end, str.size(), str.size(), to)) {
+                        return Result{1};
+                    }
+
+                    target = String(from < to ? std::string(str.view().substr(from, to - from)) : std::string());
+                } else {
+                    errorAt(formatStr("Can't slice '%s'", getTypename(target.which())));
+                    return Result{1};
+                }
                 break;
             }
 
             case OpGetUpValue: {
-                push(*frame->func->upValues[readByte()]->loc);
+                push(*frame->func->upValues[readOperand()]->loc);
                 break;
             }
 
             case OpSetUpValue: {
-                *frame->func->upValues[readByte()]->loc = peek(0);
+                *frame->func->upValues[readOperand()]->loc = peek(0);
                 break;
             }
 
             case OpPopLocals: {
-                u8 amount = readByte();
+                u16 amount = readOperand();
                 closeUpValues(stack.data() + stack.size() - amount);
                 stack.resize(stack.size() - amount);
                 break;
             }
 
             case OpJump: {
-                frame->ip += readShort();
+                frame->ip += readJump();
                 break;
             }
 
             case OpJumpBack: {
-                frame->ip -= readShort();
+                frame->ip -= readJump();
                 break;
             }
 
             case OpJumpIfTrue: {
-                u16 distance = readShort();
+                u32 distance = readJump();
                 frame->ip += isTruthy(peek(0)) * distance;
                 break;
             }
 
             case OpJumpIfFalse: {
-                u16 distance = readShort();
+                u32 distance = readJump();
                 frame->ip += !isTruthy(peek(0)) * distance;
                 break;
             }
 
             case OpJumpPopIfFalse: {
-                u16 distance = readShort();
+                u32 distance = readJump();
                 frame->ip += !isTruthy(pop()) * distance;
                 break;
             }
 
+            case OpGetIter: {
+                Value state;
+                if (!getIterator(stack.back(), state)) {
+                    return Result{1};
+                }
+
+                push(state);
+                break;
+            }
+
+            case OpForIter: {
+                Value* slots = frame->sp + readShort();
+                u32 distance = readJump();
+                if (!iterate(slots[0], slots[1], slots[2])) {
+                    frame->ip += distance;
+                }
+                break;
+            }
+
+            case OpForRange: {
+                Value* slots = frame->sp + readShort();
+                u32 distance = readJump();
+
+                if (!slots[0].is<Number>() || !slots[1].is<Number>() || !slots[2].is<Number>()) {
+                    errorAt("Range arguments must be numbers");
+                    return Result{1};
+                }
+
+                Number counter = slots[0].get<Number>();
+                Number end = slots[1].get<Number>();
+                Number step = slots[2].get<Number>();
+
+                if (step == 0) {
+                    errorAt("Range step can't be zero");
+                    return Result{1};
+                }
+
+                if (step > 0 ? counter < end : counter > end) {
+                    slots[3] = counter;
+                } else {
+                    frame->ip += distance;
+                }
+                break;
+            }
+
+            case OpForRangeLoop: {
+                // The counter's slot was checked by OpForRange and can't be reached from the loop's body
+                Value* slots = frame->sp + readShort();
+                u32 distance = readJump();
+
+                Number& counter = slots[0].get_unchecked<Number>();
+                Number end = slots[1].get_unchecked<Number>();
+                Number step = slots[2].get_unchecked<Number>();
+                counter += step;
+
+                if (step > 0 ? counter < end : counter > end) {
+                    slots[3] = counter;
+                    frame->ip -= distance;
+                }
+                break;
+            }
+
             case OpFunction: {
                 Shared<Function> func = std::make_shared<Function>();
                 func->mod = frame->mod;
-                func->prot = frame->chunk.constants.prototypes[readByte()];
+                func->prot = frame->chunk.prototypes[readOperand()];
 
-                for (int i = 0; i < func->prot.upValues; i++) {
-                    u8 index = readByte();
+                for (int i = 0; i < func->prot->upValues; i++) {
+                    u16 index = readOperand();
                     u8 isLocal = readByte();
                     if (isLocal) {
                         func->upValues.push_back(captureUpValue(frame->sp + index));
@@ -350,11 +777,66 @@ Result Interpreter::run() {
                 break;
             }
 
+            case OpCheckFunction: {
+                // Inlined calls only stay valid while the global still holds the function they came from
+                Value value = pop();
+                Shared<Prototype>& prot = frame->chunk.prototypes[readOperand()];
+                push(value.is<Shared<Function>>() && value.get<Shared<Function>>()->prot == prot);
+                break;
+            }
+
+            case OpType: {
+                Shared<Type> type = std::make_shared<Type>();
+                type->name = readNameConstant();
+                type->shape = std::make_shared<Shape>();
+                push(type);
+                break;
+            }
+
+            case OpInherit: {
+                u8 count = readByte();
+                Type& type = *stack[stack.size() - count - 1].get<Shared<Type>>();
+
+                std::vector<Shared<Type>> parents;
+                for (int i = stack.size() - count; i < (signed)stack.size(); i++) {
+                    if (!stack[i].is<Shared<Type>>()) {
+                        errorAt(formatStr("Can only inherit from types, got '%s'", getTypename(stack[i].which())));
+                        return Result{1};
+                    }
+
+                    parents.push_back(stack[i].get<Shared<Type>>());
+                }
+
+                // The type's own methods are bound afterwards and replace inherited ones
+                if (!type.inherit(parents)) {
+                    errorAt(formatStr("Can't find a consistent method order for the parents of '%s'", type.name));
+                    return Result{1};
+                }
+
+                stack.resize(stack.size() - count);
+                break;
+            }
+
+            case OpBindMethod: {
+                std::string name = readNameConstant();
+                Shared<Function> method = pop().get<Shared<Function>>();
+                stack.back().get<Shared<Type>>()->bind(name, method);
+                break;
+            }
+
+            case OpWide: {
+                // Only the next instruction reads two byte operands
+                wide = true;
+                continue;
+            }
+
             default: {
                 errorAt(formatStr("Unknown Instruction (%d)", (int)instruction));
                 return Result{1};
             }
         }
+
+        wide = false;
     }
 }
 
@@ -365,6 +847,7 @@ void Interpreter::errorAt(std::string msg) {
     std::string path = getFrame()->mod->name;
     auto& markers = getFrame()->chunk.markers;
     if (markers.size() == 0) {
+        output.flush();
         printf("Error during execution (%s)\n", path.c_str());
         printf("    %s\n", msg.c_str());
         return;
@@ -403,12 +886,25 @@ u16 Interpreter::readShort() {
     return (u16)((getFrame()->ip[-2] << 8) | getFrame()->ip[-1]);
 }
 
+u16 Interpreter::readOperand() {
+    return wide ? readShort() : readByte();
+}
+
+u32 Interpreter::readJump() {
+    if (!wide) {
+        return readShort();
+    }
+
+    u32 high = readShort();
+    return high << 16 | readShort();
+}
+
 Number Interpreter::readNumberConstant() {
-    return getFrame()->chunk.constants.numbers[readByte()];
+    return getFrame()->chunk.constants->numbers[readOperand()];
 }
 
-String Interpreter::readNameConstant() {
-    return getFrame()->chunk.constants.names[readByte()];
+std::string Interpreter::readNameConstant() {
+    return getFrame()->chunk.constants->names[readOperand()];
 }
 
 void Interpreter::push(Value value) {
@@ -430,18 +926,61 @@ Value Interpreter::peek(int offset) {
     return stack[stack.size() - offset - 1];
 }
 
+bool Interpreter::findProperty(Instance& instance, const std::string& name, InlineCache& cache) {
+    // A hit is one shape compare, the slot is then a field or a method table index
+    if (cache.shape == instance.shape && !cache.next) {
+        return true;
+    }
+
+    // Fields come first and can hide methods
+    auto slot = instance.shape->slots.find(name);
+    if (slot != instance.shape->slots.end()) {
+        cache = InlineCache{instance.shape, nullptr, slot->second, false};
+        return true;
+    }
+
+    auto method = instance.type->slots.find(name);
+    if (method == instance.type->slots.end()) {
+        errorAt(formatStr("'%s' has no property '%s'", instance.type->name, name));
+        return false;
+    }
+
+    cache = InlineCache{instance.shape, nullptr, method->second, true};
+    return true;
+}
+
 bool Interpreter::callValue(Value value) {
     switch (value.which()) {
         case Value::which<Shared<Function>>(): {
+            return callFunction(value.get<Shared<Function>>(), readByte());
+        }
+
+        case Value::which<Shared<BoundMethod>>(): {
+            // The receiver replaces the call's slot, methods read it from there as self
             u8 argc = readByte();
-            Value* sp = stack.data() + stack.size() - argc - 1;
-            auto func = value.get<Shared<Function>>();
-            if (argc != func->prot.argc) {
-                errorAt(formatStr("Expected %d argument%p, got %d", func->prot.argc, func->prot.argc > 1 ? "s" : "", argc));
+            auto& bound = value.get<Shared<BoundMethod>>();
+            stack[stack.size() - argc - 1] = bound->receiver;
+            return callFunction(bound->method, argc);
+        }
+
+        case Value::which<Shared<Type>>(): {
+            u8 argc = readByte();
+            auto& type = value.get<Shared<Type>>();
+            Shared<Instance> instance = std::make_shared<Instance>();
+            instance->type = type;
+            instance->shape = type->shape;
+            stack[stack.size() - argc - 1] = instance;
+
+            Shared<Function> init = type->findMethod("init");
+            if (init) {
+                return callFunction(init, argc);
+            }
+
+            if (argc) {
+                errorAt(formatStr("Expected 0 arguments, got %d", argc));
                 return false;
             }
 
-            newFrame(func->mod, func->prot.chunk, sp, func);
             return true;
         }
 
@@ -464,6 +1003,38 @@ bool Interpreter::callValue(Value value) {
     }
 }
 
+bool Interpreter::callFunction(Shared<Function> func, u8 argc) {
+    Value* sp = stack.data() + stack.size() - argc - 1;
+    if (argc != func->prot->argc) {
+        errorAt(formatStr("Expected %d argument%p, got %d", func->prot->argc, func->prot->argc > 1 ? "s" : "", argc));
+        return false;
+    }
+
+    if (func->prot->lazy != nullptr && !compileLazy(*func->prot)) {
+        return false;
+    }
+
+    // Frames point into the stack, so it must never grow past what was reserved
+    if (frames.size() == frames_max || stack.size() + func->prot->slots + UINT8_MAX > stack.capacity()) {
+        errorAt("Stack overflow");
+        return false;
+    }
+
+    newFrame(func->mod, func->prot->chunk, sp, func);
+    return true;
+}
+
+bool Interpreter::compileLazy(Prototype& prot) {
+    Compiler compiler = Compiler(prot.lazy->path, prot.lazy->options);
+    if (compiler.compileLazy(prot)) {
+        return true;
+    }
+
+    hadError = true;
+    error = compiler.getError();
+    return false;
+}
+
 CallFrame* Interpreter::getFrame() {
     return &frames.back();
 }
@@ -514,6 +1085,84 @@ void Interpreter::printStack() {
     print(">=============<");
 }
 
+bool Interpreter::getIterator(Value& iterable, Value& state) {
+    switch (iterable.which()) {
+        case Value::which<String>():
+            state = 0.0;
+            return true;
+
+        case Value::which<Shared<Range>>():
+            state = iterable.get<Shared<Range>>()->start;
+            return true;
+
+        case Value::which<Shared<List>>():
+        case Value::which<Shared<Dict>>():
+            state = 0.0;
+            return true;
+
+        default:
+            errorAt(formatStr("Can't iterate over '%s'", getTypename(iterable.which())));
+            return false;
+    }
+}
+
+bool Interpreter::iterate(Value& iterable, Value& state, Value& result) {
+    switch (iterable.which()) {
+        case Value::which<String>(): {
+            String& str = iterable.get<String>();
+            Number& index = state.get_unchecked<Number>();
+            if (index >= str.size()) {
+                return false;
+            }
+
+            result = String(std::string(1, str[(size_t)index++]));
+            return true;
+        }
+
+        case Value::which<Shared<Range>>(): {
+            Range& range = *iterable.get<Shared<Range>>();
+            Number& counter = state.get_unchecked<Number>();
+            if (range.step > 0 ? counter >= range.end : counter <= range.end) {
+                return false;
+            }
+
+            result = counter;
+            counter += range.step;
+            return true;
+        }
+
+        case Value::which<Shared<List>>(): {
+            // The list can shrink while it is looped over, so the size is checked every time
+            List& list = *iterable.get<Shared<List>>();
+            Number& index = state.get_unchecked<Number>();
+            if (index >= list.size()) {
+                return false;
+            }
+
+            result = list.get((size_t)index++);
+            return true;
+        }
+
+        case Value::which<Shared<Dict>>(): {
+            // Loops go over the keys in the order they were first added, the state is the next order
+            // rather than an index since adding keys in the loop can compact the entries
+            Dict& dict = *iterable.get<Shared<Dict>>();
+            Number& order = state.get_unchecked<Number>();
+            size_t index = dict.next((size_t)order);
+            if (index == dict.entries.size()) {
+                return false;
+            }
+
+            result = dict.entries[index].key;
+            order = (Number)(dict.entries[index].order + 1);
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
 bool Interpreter::valuesEqual(Value& a, Value& b) {
     if (a.which() != b.which()) {
         return false;
@@ -539,6 +1188,22 @@ bool Interpreter::valuesEqual(Value& a, Value& b) {
         return true;
     }
 
+    if (a.is<Shared<List>>()) {
+        return a.get<Shared<List>>() == b.get<Shared<List>>();
+    }
+
+    if (a.is<Shared<Dict>>()) {
+        return a.get<Shared<Dict>>() == b.get<Shared<Dict>>();
+    }
+
+    if (a.is<Shared<Type>>()) {
+        return a.get<Shared<Type>>() == b.get<Shared<Type>>();
+    }
+
+    if (a.is<Shared<Instance>>()) {
+        return a.get<Shared<Instance>>() == b.get<Shared<Instance>>();
+    }
+
     return false;
 }
 
@@ -559,7 +1224,63 @@ bool Interpreter::isTruthy(Value& value) {
         case Value::which<Shared<UpValue>>(): {
             return isTruthy(*value.get<Shared<UpValue>>()->loc);
         }
+        case Value::which<Shared<List>>(): {
+            return value.get<Shared<List>>()->size();
+        }
+        case Value::which<Shared<Dict>>(): {
+            return value.get<Shared<Dict>>()->size();
+        }
         default:
             return true;
     }
 }
+
+bool Interpreter::getIndex(Value& index, size_t size, size_t& result) {
+    if (!index.is<Number>() || std::trunc(index.get<Number>()) != index.get<Number>()) {
+        errorAt(formatStr("Index must be a whole number, got '%s'", getValueStr(index)));
+        return false;
+    }
+
+    Number number = index.get<Number>();
+    if (number < 0) {
+        number += size;
+    }
+
+    if (number < 0 || number >= size) {
+        errorAt(formatStr("Index %s is out of range for length %d", getValueStr(index), (int)size));
+        return false;
+    }
+
+    result = (size_t)number;
+    return true;
+}
+
+bool Interpreter::getSliceBound(Value& bound, size_t size, size_t fallback, size_t& result) {
+    if (bound.is<None>()) {
+        result = fallback;
+        return true;
+    }
+
+    if (!bound.is<Number>() || std::trunc(bound.get<Number>()) != bound.get<Number>()) {
+        errorAt(formatStr("Slice bounds must be whole numbers, got '%s'", getValueStr(bound)));
+        return false;
+    }
+
+    // Out of range bounds are clamped instead of being an error
+    Number number = bound.get<Number>();
+    if (number < 0) {
+        number += size;
+    }
+
+    result = (size_t)std::clamp(number, 0.0, (Number)size);
+    return true;
+}
+
+bool Interpreter::hashKey(Value& key, size_t& hash) {
+    if (!Dict::hashKey(key, hash)) {
+        errorAt(formatStr("Can't use '%s' as a dict key", getTypename(key.which())));
+        return false;
+    }
+
+    return true;
+}
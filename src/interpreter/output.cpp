@@ -0,0 +1,61 @@
+#include "interpreter/output.h"
+
+#include <cstdio>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+void StdoutSink::write(const char* data, size_t length) {
+    fwrite(data, 1, length, stdout);
+}
+
+void StdoutSink::flush() {
+    fflush(stdout);
+}
+
+bool StdoutSink::interactive() {
+    return isatty(fileno(stdout));
+}
+
+OutputBuffer::OutputBuffer(Shared<OutputSink> sink) : sink(sink) {
+    lineBuffered = sink->interactive();
+    buffer.reserve(output_buffer_size);
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+void OutputBuffer::write(std::string_view text) {
+    if (buffer.size() + text.size() > output_buffer_size) {
+        flush();
+
+        // Anything this big goes straight through instead of being copied first
+        if (text.size() > output_buffer_size) {
+            sink->write(text.data(), text.size());
+            return;
+        }
+    }
+
+    buffer.append(text);
+}
+
+void OutputBuffer::endLine() {
+    write("\n");
+    if (lineBuffered) {
+        flush();
+    }
+}
+
+void OutputBuffer::flush() {
+    if (buffer.size()) {
+        sink->write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    sink->flush();
+}
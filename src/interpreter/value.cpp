@@ -0,0 +1,388 @@
+#include "interpreter/value.h"
+
+#include <algorithm>
+
+String::String(std::string str) : buffer(std::make_shared<std::string>(std::move(str))), length(buffer->size()) {}
+
+String::String(const char* str) : String(std::string(str)) {}
+
+std::string_view String::view() const {
+    return std::string_view(buffer->data(), length);
+}
+
+std::string String::str() const {
+    return std::string(view());
+}
+
+String String::concat(const String& other) const {
+    // Strings never write below their length, so anything past it is free to take
+    if (length == buffer->size() && buffer != other.buffer) {
+        buffer->append(other.view());
+        String result = *this;
+        result.length = buffer->size();
+        return result;
+    }
+
+    std::string result;
+    result.reserve(length + other.length);
+    result.append(view());
+    result.append(other.view());
+    return String(std::move(result));
+}
+
+size_t List::size() const {
+    return boxed ? values.size() : numbers.size();
+}
+
+Value List::get(size_t index) const {
+    return boxed ? values[index] : Value(numbers[index]);
+}
+
+void List::set(size_t index, Value value) {
+    if (!boxed && value.is<Number>()) {
+        numbers[index] = value.get<Number>();
+        return;
+    }
+
+    box();
+    values[index] = std::move(value);
+}
+
+void List::push(Value value) {
+    if (!boxed && value.is<Number>()) {
+        numbers.push_back(value.get<Number>());
+        return;
+    }
+
+    box();
+    values.push_back(std::move(value));
+}
+
+void List::insert(size_t index, Value value) {
+    if (!boxed && value.is<Number>()) {
+        numbers.insert(numbers.begin() + index, value.get<Number>());
+        return;
+    }
+
+    box();
+    values.insert(values.begin() + index, std::move(value));
+}
+
+Value List::pop() {
+    if (!boxed) {
+        Number value = numbers.back();
+        numbers.pop_back();
+        return value;
+    }
+
+    Value value = std::move(values.back());
+    values.pop_back();
+    return value;
+}
+
+void List::extend(const List& other) {
+    // Extending a list by itself has to read the size before it grows
+    size_t count = other.size();
+    if (!boxed && !other.boxed) {
+        size_t start = numbers.size();
+        numbers.resize(start + count);
+        std::copy_n(other.numbers.begin(), count, numbers.begin() + start);
+        return;
+    }
+
+    box();
+    values.reserve(values.size() + count);
+    for (size_t i = 0; i < count; i++) {
+        values.push_back(other.get(i));
+    }
+}
+
+Shared<List> List::slice(size_t start, size_t end) const {
+    Shared<List> list = std::make_shared<List>();
+    list->boxed = boxed;
+
+    if (start < end) {
+        if (boxed) {
+            list->values.assign(values.begin() + start, values.begin() + end);
+        } else {
+            list->numbers.assign(numbers.begin() + start, numbers.begin() + end);
+        }
+    }
+
+    return list;
+}
+
+void List::box() {
+    if (boxed) return;
+
+    values.reserve(numbers.size());
+    for (Number number : numbers) {
+        values.push_back(number);
+    }
+
+    numbers.clear();
+    numbers.shrink_to_fit();
+    boxed = true;
+}
+
+static bool keysEqual(const Value& a, const Value& b) {
+    if (a.which() != b.which()) {
+        return false;
+    }
+
+    switch (a.which()) {
+        case Value::which<Number>():
+            return a.get<Number>() == b.get<Number>();
+        case Value::which<String>():
+            return a.get<String>() == b.get<String>();
+        case Value::which<Boolean>():
+            return a.get<Boolean>() == b.get<Boolean>();
+        default:
+            return true;
+    }
+}
+
+bool Dict::hashKey(const Value& key, size_t& hash) {
+    switch (key.which()) {
+        case Value::which<Number>(): {
+            // Zero and negative zero are the same key
+            Number number = key.get<Number>();
+            hash = std::hash<Number>()(number == 0 ? 0 : number);
+            return true;
+        }
+        case Value::which<String>():
+            hash = std::hash<std::string_view>()(key.get<String>().view());
+            return true;
+        case Value::which<Boolean>():
+            hash = key.get<Boolean>() ? 0x9e3779b9 : 0x7f4a7c15;
+            return true;
+        case Value::which<None>():
+            hash = 0x85ebca6b;
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t Dict::size() const {
+    return count;
+}
+
+Value* Dict::find(const Value& key, size_t hash) {
+    int slot = findSlot(key, hash);
+    return slot == -1 ? nullptr : &entries[slots[slot].entry - 1].value;
+}
+
+void Dict::set(const Value& key, size_t hash, Value value) {
+    int slot = findSlot(key, hash);
+    if (slot != -1) {
+        entries[slots[slot].entry - 1].value = std::move(value);
+        return;
+    }
+
+    // Kept at most 3/4 full, removed entries are dropped whenever the slots are rebuilt
+    if ((count + 1) * 4 > slots.size() * 3) {
+        rebuild(std::max<size_t>(8, slots.size() * 2));
+    } else if (entries.size() > count * 2 + 8) {
+        rebuild(slots.size());
+    }
+
+    entries.push_back(Entry{key, std::move(value), hash, added++, false});
+    place(entries.size(), (u32)hash);
+    count++;
+}
+
+bool Dict::remove(const Value& key, size_t hash) {
+    int slot = findSlot(key, hash);
+    if (slot == -1) {
+        return false;
+    }
+
+    Entry& entry = entries[slots[slot].entry - 1];
+    entry.key = None{};
+    entry.value = None{};
+    entry.removed = true;
+    count--;
+
+    // Backward shift deletion, following slots move back until one is empty or already where it wants to be
+    size_t mask = slots.size() - 1;
+    size_t pos = slot;
+    while (true) {
+        size_t next = (pos + 1) & mask;
+        Slot& moved = slots[next];
+        if (!moved.entry || ((next - (moved.hash & mask)) & mask) == 0) {
+            break;
+        }
+
+        slots[pos] = moved;
+        pos = next;
+    }
+
+    slots[pos] = Slot{0, 0};
+    return true;
+}
+
+size_t Dict::next(size_t order) const {
+    // An entry is never after its order, until a rebuild drops removed entries the two are the same
+    size_t index = std::min(order, entries.size());
+    if (index == entries.size() || entries[index].order != order) {
+        index = std::lower_bound(entries.begin(), entries.begin() + index, order, [](const Entry& entry, size_t order) {
+            return entry.order < order;
+        }) - entries.begin();
+    }
+
+    while (index < entries.size() && entries[index].removed) {
+        index++;
+    }
+
+    return index;
+}
+
+int Dict::findSlot(const Value& key, size_t hash) const {
+    if (slots.empty()) {
+        return -1;
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t pos = hash & mask;
+    for (size_t distance = 0;; distance++) {
+        const Slot& slot = slots[pos];
+
+        // A slot closer to its home than the key would be means the key was never placed
+        if (!slot.entry || ((pos - (slot.hash & mask)) & mask) < distance) {
+            return -1;
+        }
+
+        if (slot.hash == (u32)hash && keysEqual(entries[slot.entry - 1].key, key)) {
+            return pos;
+        }
+
+        pos = (pos + 1) & mask;
+    }
+}
+
+void Dict::place(u32 entry, u32 hash) {
+    size_t mask = slots.size() - 1;
+    size_t pos = hash & mask;
+    size_t distance = 0;
+    Slot slot = Slot{entry, hash};
+
+    while (slots[pos].entry) {
+        // Robin Hood, whichever slot is further from home keeps the position
+        size_t other = (pos - (slots[pos].hash & mask)) & mask;
+        if (other < distance) {
+            std::swap(slot, slots[pos]);
+            distance = other;
+        }
+
+        pos = (pos + 1) & mask;
+        distance++;
+    }
+
+    slots[pos] = slot;
+}
+
+void Dict::rebuild(size_t capacity) {
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!entries[i].removed) {
+            entries[kept++] = std::move(entries[i]);
+        }
+    }
+    entries.resize(kept);
+
+    slots.assign(capacity, Slot{0, 0});
+    for (size_t i = 0; i < entries.size(); i++) {
+        place(i + 1, (u32)entries[i].hash);
+    }
+}
+
+Shared<Shape> Shape::transition(const std::string& name) {
+    Shared<Shape>& next = transitions[name];
+    if (!next) {
+        next = std::make_shared<Shape>();
+        next->slots = slots;
+        next->slots.emplace(name, slots.size());
+    }
+
+    return next;
+}
+
+bool Type::inherit(std::vector<Shared<Type>> parents) {
+    // Each parent's own linearization, then the parents in the order they were listed
+    std::vector<std::vector<Shared<Type>>> sequences;
+    for (auto& parent : parents) {
+        sequences.push_back({parent});
+        sequences.back().insert(sequences.back().end(), parent->ancestors.begin(), parent->ancestors.end());
+    }
+    sequences.push_back(parents);
+
+    std::vector<size_t> heads(sequences.size(), 0);
+    auto inTail = [&](Shared<Type>& type) {
+        for (size_t i = 0; i < sequences.size(); i++) {
+            if (heads[i] < sequences[i].size() && std::find(sequences[i].begin() + heads[i] + 1, sequences[i].end(), type) != sequences[i].end()) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Repeatedly take the first head that doesn't have to come after something else
+    std::vector<Shared<Type>> linearized;
+    while (true) {
+        Shared<Type> next;
+        bool remaining = false;
+
+        for (size_t i = 0; i < sequences.size() && !next; i++) {
+            if (heads[i] == sequences[i].size()) continue;
+
+            remaining = true;
+            if (!inTail(sequences[i][heads[i]])) {
+                next = sequences[i][heads[i]];
+            }
+        }
+
+        if (!remaining) break;
+        if (!next) return false;
+
+        for (size_t i = 0; i < sequences.size(); i++) {
+            if (heads[i] < sequences[i].size() && sequences[i][heads[i]] == next) {
+                heads[i]++;
+            }
+        }
+        linearized.push_back(std::move(next));
+    }
+
+    this->parents = std::move(parents);
+    ancestors = std::move(linearized);
+
+    // Only methods a type declared itself count, inherited ones may resolve differently here
+    for (auto& ancestor : ancestors) {
+        for (auto& [name, method] : ancestor->declared) {
+            if (!slots.count(name)) {
+                slots.emplace(name, methods.size());
+                methods.push_back(method);
+            }
+        }
+    }
+
+    return true;
+}
+
+void Type::bind(const std::string& name, Shared<Function> method) {
+    declared[name] = method;
+
+    auto slot = slots.find(name);
+    if (slot != slots.end()) {
+        methods[slot->second] = method;
+        return;
+    }
+
+    slots.emplace(name, methods.size());
+    methods.push_back(method);
+}
+
+Shared<Function> Type::findMethod(const std::string& name) {
+    auto slot = slots.find(name);
+    return slot == slots.end() ? nullptr : methods[slot->second];
+}
@@ -20,13 +20,15 @@ std::string openFile(std::string path) {
     return stream.str();
 }
 
-void runFile(std::string path) {
+void runFile(std::string path, Options options) {
     State state;
+    state.options = options;
     state.run(openFile(path));
 }
 
 void repl() {
     State state;
+    state.options.singlePass = true;
     std::string input;
     for (;;) {
         printf(">>> ");
@@ -40,22 +42,46 @@ void repl() {
     }
 }
 
+void usage() {
+    print("[Usage] jake-lang [options] (path)");
+    print("    --repl         Read and run lines interactively");
+    print("    --lazy         Compile top level functions on their first call");
+    print("    --single-pass  Try the single pass compiler first");
+    print("    -O0 to -O3     Optimization level of the ir tier");
+    print("    --dump-ir      Print the ir of every optimized function");
+    print("    --timings      Print how long parsing and compiling took");
+    print("    --stats        Print chunk sizes before and after the peephole pass");
+}
+
 int main(int argc, const char* argv[]) {
-    runFile("./test/code.jake");
-    
-    // switch (argc) {
-    //     case 1:
-    //         repl();
-    //         break;
-
-    //     case 2:
-    //         runFile(argv[1]);
-    //         break;
-
-    //     default:
-    //         print("[Usage] jake-lang (path)");
-    //         break;
-    // }
+    Options options;
+    std::string path = "./test/code.jake";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--repl") {
+            repl();
+            return 0;
+        } else if (arg == "--lazy") {
+            options.lazyCompile = true;
+        } else if (arg == "--single-pass") {
+            options.singlePass = true;
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            options.optimizeLevel = arg[2] - '0';
+        } else if (arg == "--dump-ir") {
+            options.dumpIr = true;
+        } else if (arg == "--timings") {
+            options.showTimings = true;
+        } else if (arg == "--stats") {
+            options.showChunkStats = true;
+        } else if (arg[0] == '-') {
+            usage();
+            return 1;
+        } else {
+            path = arg;
+        }
+    }
 
+    runFile(path, options);
     return 0;
-}
\ No newline at end of file
+}
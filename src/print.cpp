@@ -1,5 +1,6 @@
 #include "print.h"
 
+#include <algorithm>
 #include <iomanip>
 #include "color.h"
 #include "compiler/compiler.h"
@@ -7,14 +8,16 @@
 #include "syntax/ast.h"
 
 void printStmt(const Stmt& stmt, int indent);
-int disassembleInstruction(const Chunk& chunk, int index);
+int disassembleInstruction(const Chunk& chunk, int index, bool wide = false);
 
 void printToken(const Token& token) {
     static const char* names[] = {
         "LeftParen", "RightParen",
         "LeftBrace", "RightBrace",
+        "LeftBracket", "RightBracket",
         "Comma", "Dot", "Plus", "Minus",
         "Slash", "Asterisk", "Carret", "Semicolon",
+        "Colon",
         "Percent",
 
         "Bang", "BangEqual",
@@ -24,10 +27,10 @@ void printToken(const Token& token) {
         "MinusEqual", "AsteriskEqual", "SlashEqual",
         "CarretEqual",
 
-        "Identifier", "String", "Number", "True", "False", "None",
+        "Identifier", "String", "FormatString", "Number", "True", "False", "None",
 
         "Print", "If", "Else", "Loop", "While", "For", "In", "Continue",
-        "Break", "Func", "Var", "Exit", "And", "Or", "Type",
+        "Break", "Func", "Var", "Const", "Exit", "And", "Or", "Type",
 
         "Error", "EndOfFile"};
 
@@ -172,6 +175,51 @@ void printExpr(const Expr& expr, int indent) {
             break;
         }
 
+        case Expr::which<Ptr<ListExpr>>(): {
+            auto& val = expr.get<Ptr<ListExpr>>();
+            print("ListExpr{}", val->items.size() ? "" : "(empty)");
+            for (auto& item : val->items) {
+                printExpr(item, indent + 1);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<DictExpr>>(): {
+            auto& val = expr.get<Ptr<DictExpr>>();
+            print("DictExpr{}", val->keys.size() ? "" : "(empty)");
+            for (int i = 0; i < (signed)val->keys.size(); i++) {
+                printExpr(val->keys[i], indent + 1);
+                printExpr(val->values[i], indent + 2);
+            }
+            break;
+        }
+
+        case Expr::which<Ptr<IndexExpr>>(): {
+            auto& val = expr.get<Ptr<IndexExpr>>();
+            print("IndexExpr{}");
+            printExpr(val->expr, indent + 1);
+            printExpr(val->index, indent + 1);
+            break;
+        }
+
+        case Expr::which<Ptr<SliceExpr>>(): {
+            auto& val = expr.get<Ptr<SliceExpr>>();
+            print("SliceExpr{}");
+            printExpr(val->expr, indent + 1);
+            printExpr(val->start, indent + 1);
+            printExpr(val->end, indent + 1);
+            break;
+        }
+
+        case Expr::which<Ptr<FormatExpr>>(): {
+            auto& val = expr.get<Ptr<FormatExpr>>();
+            print("FormatExpr{}");
+            for (auto& part : val->parts) {
+                printExpr(part, indent + 1);
+            }
+            break;
+        }
+
         case Expr::which<Empty>(): {
             print("Empty{}");
             break;
@@ -336,7 +384,7 @@ void printStmt(const Stmt& stmt, int indent) {
 
         case Stmt::which<Ptr<VarDeclaration>>(): {
             auto val = stmt.get<Ptr<VarDeclaration>>();
-            printf("ValDeclaration{%s}\n", val->target.name.c_str());
+            printf("%s{%s}\n", val->constant ? "ConstDeclaration" : "ValDeclaration", val->target.name.c_str());
             printExpr(val->expr, indent + 1);
             break;
         }
@@ -374,13 +422,17 @@ int simpleInstruction(const char* name, int index) {
     return index + 1;
 }
 
-int constantInstruction(const char* name, int index, const Chunk& chunk, bool isName = false) {
-    int constant = chunk.bytecode[index + 1];
+int readOperand(const Chunk& chunk, int index, bool wide) {
+    return wide ? chunk.bytecode[index] << 8 | chunk.bytecode[index + 1] : chunk.bytecode[index];
+}
+
+int constantInstruction(const char* name, int index, const Chunk& chunk, bool isName = false, bool wide = false) {
+    int constant = readOperand(chunk, index + 1, wide);
 
     if (isName) {
-        printf("%-16s %s (%d)\n", name, chunk.constants.names[constant].c_str(), constant);
+        printf("%-16s %s (%d)\n", name, chunk.constants->names[constant].c_str(), constant);
     } else {
-        double val = chunk.constants.numbers[constant];
+        double val = chunk.constants->numbers[constant];
         if (val == (int)val) {
             printf("%-16s %4d (%d)\n", name, (int)val, constant);
         } else {
@@ -388,27 +440,63 @@ int constantInstruction(const char* name, int index, const Chunk& chunk, bool is
         }
     }
 
-    return index + 2;
+    return index + (wide ? 3 : 2);
+}
+
+int propertyInstruction(const char* name, int index, const Chunk& chunk, bool wide = false) {
+    int constant = readOperand(chunk, index + 1, wide);
+    int cache = readOperand(chunk, index + (wide ? 3 : 2), wide);
+    printf("%-16s %s (%d), cache: %d\n", name, chunk.constants->names[constant].c_str(), constant, cache);
+    return index + (wide ? 5 : 3);
+}
+
+int invokeInstruction(const char* name, int index, const Chunk& chunk, bool wide = false) {
+    int constant = readOperand(chunk, index + 1, wide);
+    int cache = readOperand(chunk, index + (wide ? 3 : 2), wide);
+    int argc = chunk.bytecode[index + (wide ? 5 : 3)];
+    printf("%-16s %s (%d), cache: %d, args: %d\n", name, chunk.constants->names[constant].c_str(), constant, cache, argc);
+    return index + (wide ? 6 : 4);
 }
 
-int byteInstruction(const char* name, int index, const Chunk& chunk) {
-    printf("%-16s %4d\n", name, chunk.bytecode[index + 1]);
-    return index + 2;
+int byteInstruction(const char* name, int index, const Chunk& chunk, bool wide = false) {
+    printf("%-16s %4d\n", name, readOperand(chunk, index + 1, wide));
+    return index + (wide ? 3 : 2);
 }
 
-int jumpInstruction(const char* name, int index, const Chunk& chunk, bool back = false) {
-    int val = chunk.bytecode[index + 1] << 8 | chunk.bytecode[index + 2];
-    printf("%-16s %4d to %d\n", name, val, index + (back ? -val : val) + 3);
-    return index + 3;
+int jumpInstruction(const char* name, int index, const Chunk& chunk, bool back = false, bool wide = false) {
+    int val = readOperand(chunk, index + 1, true);
+    int length = 3;
+    if (wide) {
+        val = val << 16 | readOperand(chunk, index + 3, true);
+        length = 5;
+    }
+
+    printf("%-16s %4d to %d\n", name, val, index + (back ? -val : val) + length);
+    return index + length;
+}
+
+int loopInstruction(const char* name, int index, const Chunk& chunk, bool back = false, bool wide = false) {
+    int slot = readOperand(chunk, index + 1, true);
+    int val = readOperand(chunk, index + 3, true);
+    int length = 5;
+    if (wide) {
+        val = val << 16 | readOperand(chunk, index + 5, true);
+        length = 7;
+    }
+
+    printf("%-16s %4d, slot: %d to %d\n", name, val, slot, index + (back ? -val : val) + length);
+    return index + length;
 }
 
-int functionInstruction(const char* name, int index, const Chunk& chunk) {
-    int prototypeIndex = chunk.bytecode[++index];
-    const Prototype& prototype = chunk.constants.prototypes[prototypeIndex];
+int functionInstruction(const char* name, int index, const Chunk& chunk, bool wide = false) {
+    int prototypeIndex = readOperand(chunk, ++index, wide);
+    index += wide;
+    const Prototype& prototype = *chunk.prototypes[prototypeIndex];
     printf("%-16s %4d, argc: %d\n", name, prototypeIndex, prototype.argc);
     printf(">=== %s ===<\n", prototype.name.c_str());
     for (int i = 0; i < prototype.upValues; i++) {
-        u8 upValueIndex = chunk.bytecode[++index];
+        int upValueIndex = readOperand(chunk, ++index, wide);
+        index += wide;
         u8 isLocal = chunk.bytecode[++index];
         printf("UpValue >> index: %d, isLocal: %s\n", upValueIndex, isLocal ? "true" : "false");
     }
@@ -422,7 +510,7 @@ int functionInstruction(const char* name, int index, const Chunk& chunk) {
     return index + 1;
 }
 
-int disassembleInstruction(const Chunk& chunk, int index) {
+int disassembleInstruction(const Chunk& chunk, int index, bool wide) {
     printf("%04d ", index);
 
     switch (chunk.bytecode[index]) {
@@ -436,10 +524,10 @@ int disassembleInstruction(const Chunk& chunk, int index) {
             index = simpleInstruction("Pop", index);
             break;
         case OpNumber:
-            index = constantInstruction("Number", index, chunk, false);
+            index = constantInstruction("Number", index, chunk, false, wide);
             break;
         case OpName:
-            index = constantInstruction("Name", index, chunk, true);
+            index = constantInstruction("Name", index, chunk, true, wide);
             break;
         case OpByteNumber:
             index = byteInstruction("ByteNumber", index, chunk);
@@ -473,6 +561,9 @@ int disassembleInstruction(const Chunk& chunk, int index) {
         case OpEqual:
             index = simpleInstruction("Equal", index);
             break;
+        case OpNotEqual:
+            index = simpleInstruction("NotEqual", index);
+            break;
         case OpGreater:
             index = simpleInstruction("Greater", index);
             break;
@@ -491,60 +582,136 @@ int disassembleInstruction(const Chunk& chunk, int index) {
         case OpNegate:
             index = simpleInstruction("Negate", index);
             break;
+        case OpAddNumbers:
+            index = simpleInstruction("AddNumbers", index);
+            break;
+        case OpSubtractNumbers:
+            index = simpleInstruction("SubtractNumbers", index);
+            break;
+        case OpMultiplyNumbers:
+            index = simpleInstruction("MultiplyNumbers", index);
+            break;
+        case OpDivideNumbers:
+            index = simpleInstruction("DivideNumbers", index);
+            break;
+        case OpGreaterNumbers:
+            index = simpleInstruction("GreaterNumbers", index);
+            break;
+        case OpLessNumbers:
+            index = simpleInstruction("LessNumbers", index);
+            break;
+        case OpGreaterThanOrEqNumbers:
+            index = simpleInstruction("GreaterThanOrEqNumbers", index);
+            break;
+        case OpLessThanOrEqNumbers:
+            index = simpleInstruction("LessThanOrEqNumbers", index);
+            break;
+        case OpNegateNumber:
+            index = simpleInstruction("NegateNumber", index);
+            break;
         case OpPrint:
             index = byteInstruction("Print", index, chunk);
             break;
         case OpDefineGlobal:
-            index = constantInstruction("DefineGlobal", index, chunk, true);
+            index = constantInstruction("DefineGlobal", index, chunk, true, wide);
             break;
         case OpGetGlobal:
-            index = constantInstruction("GetGlobal", index, chunk, true);
+            index = constantInstruction("GetGlobal", index, chunk, true, wide);
             break;
         case OpSetGlobal:
-            index = constantInstruction("SetGlobal", index, chunk, true);
+            index = constantInstruction("SetGlobal", index, chunk, true, wide);
             break;
         case OpGetLocal:
-            index = byteInstruction("GetLocal", index, chunk);
+            index = byteInstruction("GetLocal", index, chunk, wide);
             break;
         case OpSetLocal:
-            index = byteInstruction("SetLocal", index, chunk);
+            index = byteInstruction("SetLocal", index, chunk, wide);
             break;
         case OpGetProperty:
-            index = constantInstruction("GetProperty", index, chunk, true);
+            index = propertyInstruction("GetProperty", index, chunk, wide);
             break;
         case OpSetProperty:
-            index = constantInstruction("SetProperty", index, chunk, true);
+            index = propertyInstruction("SetProperty", index, chunk, wide);
+            break;
+        case OpList:
+            index = byteInstruction("List", index, chunk);
+            break;
+        case OpDict:
+            index = byteInstruction("Dict", index, chunk);
+            break;
+        case OpGetIndex:
+            index = simpleInstruction("GetIndex", index);
+            break;
+        case OpSetIndex:
+            index = simpleInstruction("SetIndex", index);
+            break;
+        case OpSlice:
+            index = simpleInstruction("Slice", index);
+            break;
+        case OpBuildString:
+            index = byteInstruction("BuildString", index, chunk);
             break;
         case OpGetUpValue:
-            index = byteInstruction("GetUpValue", index, chunk);
+            index = byteInstruction("GetUpValue", index, chunk, wide);
             break;
         case OpSetUpValue:
-            index = byteInstruction("SetUpValue", index, chunk);
+            index = byteInstruction("SetUpValue", index, chunk, wide);
             break;
         case OpPopLocals:
-            index = byteInstruction("CloseUpValue", index, chunk);
+            index = byteInstruction("CloseUpValue", index, chunk, wide);
             break;
         case OpJump:
-            index = jumpInstruction("Jump", index, chunk);
+            index = jumpInstruction("Jump", index, chunk, false, wide);
             break;
         case OpJumpBack:
-            index = jumpInstruction("JumpBack", index, chunk, true);
+            index = jumpInstruction("JumpBack", index, chunk, true, wide);
             break;
         case OpJumpIfTrue:
-            index = jumpInstruction("JumpIfTrue", index, chunk);
+            index = jumpInstruction("JumpIfTrue", index, chunk, false, wide);
             break;
         case OpJumpIfFalse:
-            index = jumpInstruction("JumpIfFalse", index, chunk);
+            index = jumpInstruction("JumpIfFalse", index, chunk, false, wide);
             break;
         case OpJumpPopIfFalse:
-            index = jumpInstruction("JumpPopIfFalse", index, chunk);
+            index = jumpInstruction("JumpPopIfFalse", index, chunk, false, wide);
+            break;
+        case OpGetIter:
+            index = simpleInstruction("GetIter", index);
+            break;
+        case OpForIter:
+            index = loopInstruction("ForIter", index, chunk, false, wide);
+            break;
+        case OpForRange:
+            index = loopInstruction("ForRange", index, chunk, false, wide);
+            break;
+        case OpForRangeLoop:
+            index = loopInstruction("ForRangeLoop", index, chunk, true, wide);
             break;
         case OpFunction:
-            index = functionInstruction("Function", index, chunk);
+            index = functionInstruction("Function", index, chunk, wide);
             break;
         case OpCall:
             index = byteInstruction("Call", index, chunk);
             break;
+        case OpInvoke:
+            index = invokeInstruction("Invoke", index, chunk, wide);
+            break;
+        case OpCheckFunction:
+            index = byteInstruction("CheckFunction", index, chunk, wide);
+            break;
+        case OpType:
+            index = constantInstruction("Type", index, chunk, true, wide);
+            break;
+        case OpInherit:
+            index = byteInstruction("Inherit", index, chunk);
+            break;
+        case OpBindMethod:
+            index = constantInstruction("BindMethod", index, chunk, true, wide);
+            break;
+        case OpWide:
+            printf("Wide\n");
+            index = disassembleInstruction(chunk, index + 1, true);
+            break;
 
         default:
             print("Unknown Instruction");
@@ -567,6 +734,56 @@ void printChunk(const Chunk& chunk, std::string name) {
     printf(">====%s====<\n", std::string(name.size(), '=').c_str());
 }
 
+void printIr(const IrFunction& func) {
+    static const char* names[] = {
+        "param", "number", "string", "true", "false", "none", "phi",
+        "add", "subtract", "modulous", "multiply", "divide", "exponent",
+        "equal", "not_equal", "greater", "less", "greater_or_eq", "less_or_eq",
+        "not", "negate", "get_global", "set_global", "get_upvalue", "set_upvalue",
+        "get_property", "set_property", "call", "invoke", "check_function", "print",
+        "jump", "branch", "return", "exit"};
+
+    std::string name = "ir " + func.name;
+    printf(">=== %s ===<\n", name.c_str());
+
+    for (int index = 0; index < (signed)func.blocks.size(); index++) {
+        auto& block = func.blocks[index];
+        if (block.removed) continue;
+
+        printf("b%d:", index);
+        for (int pred : block.preds) {
+            printf(" <- b%d", pred);
+        }
+        printf("\n");
+
+        for (int i : block.instructions) {
+            auto& inst = func.instructions[i];
+            if (producesValue(inst.op)) {
+                printf("    v%-4d = %s", i, names[inst.op]);
+            } else {
+                printf("    %s", names[inst.op]);
+            }
+
+            if (inst.op == IrNumber) {
+                printf(" %g", inst.number);
+            } else if (inst.op == IrParam || inst.op == IrString || inst.op == IrCall || inst.op == IrInvoke || inst.op == IrCheckFunction || inst.op == IrExit || (inst.op >= IrGetGlobal && inst.op <= IrSetProperty)) {
+                printf(" #%d", inst.operand);
+            }
+
+            for (int arg : inst.args) {
+                printf(" v%d", arg);
+            }
+
+            for (int succ : block.succs) {
+                if (isTerminator(inst.op)) printf(" b%d", succ);
+            }
+            printf("\n");
+        }
+    }
+
+    printf(">====%s====<\n", std::string(name.size(), '=').c_str());
+}
+
 std::string getTypename(int which) {
     switch (which) {
         case Value::which<Number>():
@@ -583,18 +800,71 @@ std::string getTypename(int which) {
             return "Function";
         case Value::which<Shared<Module>>():
             return "Module";
+        case Value::which<Shared<Range>>():
+            return "Range";
+        case Value::which<Shared<List>>():
+            return "List";
+        case Value::which<Shared<Dict>>():
+            return "Dict";
+        case Value::which<Shared<Type>>():
+            return "Type";
+        case Value::which<Shared<Instance>>():
+            return "Instance";
+        case Value::which<Shared<BoundMethod>>():
+            return "BoundMethod";
         default:
             return "Unknown";
     }
 }
 
+static std::string getValueStr(const Value& value, std::vector<const void*>& open);
+
+// Collections already being printed show up as [...] or {...} instead of recursing forever
+static std::string listStr(const List& list, std::vector<const void*>& open) {
+    if (std::find(open.begin(), open.end(), &list) != open.end()) {
+        return "[...]";
+    }
+
+    open.push_back(&list);
+    std::string str = "[";
+    for (size_t i = 0; i < list.size(); i++) {
+        if (i) str += ", ";
+        str += getValueStr(list.get(i), open);
+    }
+    open.pop_back();
+
+    return str + "]";
+}
+
+static std::string dictStr(const Dict& dict, std::vector<const void*>& open) {
+    if (std::find(open.begin(), open.end(), &dict) != open.end()) {
+        return "{...}";
+    }
+
+    open.push_back(&dict);
+    std::string str = "{";
+    for (auto& entry : dict.entries) {
+        if (entry.removed) continue;
+        if (str.size() > 1) str += ", ";
+        str += getValueStr(entry.key, open) + ": " + getValueStr(entry.value, open);
+    }
+    open.pop_back();
+
+    return str + "}";
+}
+
 std::string getValueStr(const Value& value) {
+    std::vector<const void*> open;
+    return getValueStr(value, open);
+}
+
+static std::string getValueStr(const Value& value, std::vector<const void*>& open) {
     switch (value.which()) {
         case Value::which<Number>(): {
-            return formatStr("%lf", value.get<Number>());
+            return numberStr(value.get<Number>());
         }
         case Value::which<String>(): {
-            return value.get<String>();
+            return value.get<String>().str();
         }
         case Value::which<Boolean>(): {
             return value.get<bool>() ? "true" : "false";
@@ -604,11 +874,11 @@ std::string getValueStr(const Value& value) {
         }
         case Value::which<Shared<UpValue>>(): {
             auto& val = value.get<Shared<UpValue>>();
-            return formatStr("UpValue{%s}", getValueStr(*val->loc));
+            return formatStr("UpValue{%s}", getValueStr(*val->loc, open));
         }
         case Value::which<Shared<Function>>(): {
             auto val = value.get<Shared<Function>>();
-            return formatStr("Function{%s, argc: %d}", val->prot.name, val->prot.argc);
+            return formatStr("Function{%s, argc: %d}", val->prot->name, val->prot->argc);
         }
         case Value::which<Shared<BuiltInFunction>>(): {
             auto val = value.get<Shared<BuiltInFunction>>();
@@ -618,6 +888,26 @@ std::string getValueStr(const Value& value) {
             auto& val = value.get<Shared<Module>>();
             return formatStr("Module{%s}", val->name);
         }
+        case Value::which<Shared<Range>>(): {
+            auto& val = value.get<Shared<Range>>();
+            return formatStr("Range{%s, %s, %s}", getValueStr(val->start), getValueStr(val->end), getValueStr(val->step));
+        }
+        case Value::which<Shared<List>>(): {
+            return listStr(*value.get<Shared<List>>(), open);
+        }
+        case Value::which<Shared<Dict>>(): {
+            return dictStr(*value.get<Shared<Dict>>(), open);
+        }
+        case Value::which<Shared<Type>>(): {
+            return formatStr("Type{%s}", value.get<Shared<Type>>()->name);
+        }
+        case Value::which<Shared<Instance>>(): {
+            return formatStr("Instance{%s}", value.get<Shared<Instance>>()->type->name);
+        }
+        case Value::which<Shared<BoundMethod>>(): {
+            auto& val = value.get<Shared<BoundMethod>>();
+            return formatStr("BoundMethod{%s}", val->method->prot->name);
+        }
         default:
             return "Unknown{}";
     }
@@ -2,10 +2,12 @@
 
 #include "builtins.h"
 #include "compiler/compiler.h"
+#include "compiler/singlepass.h"
 #include "interpreter/interpreter.h"
 #include "print.h"
 #include "syntax/ast.h"
 #include "syntax/parser.h"
+#include "timer.h"
 
 State::State() {
     base = std::make_shared<Module>();
@@ -16,23 +18,60 @@ State::State() {
 }
 
 Result State::run(std::string source) {
-    Parser parser = Parser(source, base->name);
-    Ast ast = parser.parse();
+    Timer<std::chrono::microseconds> parseTimer, compileTimer;
 
+    CompileOptions compileOptions;
+    compileOptions.lazy = options.lazyCompile;
+    compileOptions.showStats = options.showChunkStats;
+    compileOptions.optimizeLevel = options.optimizeLevel;
+    compileOptions.dumpIr = options.dumpIr;
+
+    // Anything the single pass compiler doesn't handle, errors included, goes through the full pipeline
+    if (options.singlePass) {
+        compileTimer.tick();
+        SinglePassCompiler compiler = SinglePassCompiler(source, base->name, compileOptions);
+        Chunk chunk = compiler.compile();
+        compileTimer.tock();
+
+        if (!compiler.failed()) {
+            if (options.showTimings) {
+                printf("Compiled in %lldus (single pass)\n", (long long)compileTimer.duration().count());
+            }
+
+            return execute(chunk, source);
+        }
+    }
+
+    // Function bodies are only skipped when lazy compilation was asked for, otherwise every
+    // syntax error is reported before anything runs
+    parseTimer.tick();
+    Parser parser = Parser(source, base->name, options.lazyCompile);
+    Shared<Ast> ast = std::make_shared<Ast>(parser.parse());
+    parseTimer.tock();
 
     if (parser.failed()) {
         printError(parser.getError(), source);
         return Result{ExitCode::Failed};
     }
 
-    Compiler compiler = Compiler(base->name);
+    compileTimer.tick();
+    Compiler compiler = Compiler(base->name, compileOptions);
     Chunk chunk = compiler.compile(ast);
+    compileTimer.tock();
 
     if (compiler.failed()) {
         printError(compiler.getError(), source);
         return Result{ExitCode::Failed};
     }
 
+    if (options.showTimings) {
+        printf("Parsed in %lldus, compiled in %lldus\n", (long long)parseTimer.duration().count(), (long long)compileTimer.duration().count());
+    }
+
+    return execute(chunk, source);
+}
+
+Result State::execute(Chunk& chunk, std::string& source) {
     Interpreter interpreter = Interpreter(*this);
     Result res = interpreter.interpret(base, chunk);
 
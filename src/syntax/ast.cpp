@@ -9,20 +9,28 @@ SourceView operator|(const SourceView& left, const SourceView& right) {
     return SourceView{index, length, line, column};
 }
 
+template <typename T>
+static SourceView nodeView(const T& node) {
+    if constexpr (std::is_base_of_v<AstNode, T>) {
+        return node.view;
+    }
+    return SourceView{};
+}
+
+// Most nodes are boxed, the view is on the node itself
+template <typename T>
+static SourceView nodeView(const Ptr<T>& node) {
+    return nodeView(*node);
+}
+
 SourceView getSourceView(Expr& expr) {
     return expr.match([](const auto& node) -> SourceView {
-        if constexpr (std::is_base_of_v<AstNode, std::decay_t<decltype(node)>>) {
-            return node.view;
-        }
-        return SourceView{};
+        return nodeView(node);
     });
 }
 
 SourceView getSourceView(Stmt& stmt) {
     return stmt.match([](const auto& node) -> SourceView {
-        if constexpr (std::is_base_of_v<AstNode, std::decay_t<decltype(node)>>) {
-            return node.view;
-        }
-        return SourceView{};
+        return nodeView(node);
     });
 }
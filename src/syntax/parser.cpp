@@ -3,22 +3,56 @@
 #include "print.h"
 #include "util.h"
 
-Parser::Parser(std::string& src, std::string& path) : source(src), scanner(src), path(path) {
+Parser::Parser(std::string& src, std::string& path, bool lazy) : scanner(src), source(src), path(path) {
     hadError = false;
+    this->lazy = lazy;
+    tokenIndex = 0;
+}
+
+Parser::Parser(std::string& src, std::string& path, SourceView range) : scanner(src, range.index, range.index + range.length, range.line), source(src), path(path) {
+    hadError = false;
+    lazy = false;
+    tokenIndex = 0;
 }
 
 Ast Parser::parse() {
     Ast ast;
     ast.source = source;
 
+    if (source.size() >= parallel_scan_threshold) {
+        tokens = scanParallel(source);
+    }
+
     advance();
     while (!isFinished()) {
-        ast.body.push_back(statement());
+        ast.body.push_back(lazy && check(TokenType::Func) ? funcDeclaration(true) : statement());
     }
 
+    ast.skippedNames = std::move(skippedNames);
     return ast;
 }
 
+std::vector<Stmt> Parser::parseBody() {
+    std::vector<Stmt> body;
+
+    advance();
+    while (!isFinished()) {
+        body.push_back(statement());
+    }
+
+    return body;
+}
+
+Expr Parser::parseExpression() {
+    advance();
+    Expr expr = expression();
+    if (!check(TokenType::EndOfFile)) {
+        errorAt(cur, "Expected '}' after format string expression");
+    }
+
+    return expr;
+}
+
 bool Parser::failed() {
     return hadError;
 }
@@ -31,13 +65,20 @@ void Parser::advance() {
     if (hadError) return;
 
     prev = cur;
-    cur = scanner.nextToken();
+    cur = nextToken();
 
     if (cur.type == TokenType::Error) {
         errorAt(cur, formatStr("Invalid Token: %s", cur.value));
     }
 }
 
+Token Parser::nextToken() {
+    if (tokens.empty()) return scanner.nextToken();
+    if (tokenIndex + 1 < tokens.size()) return std::move(tokens[tokenIndex++]);
+
+    return tokens.back();
+}
+
 void Parser::errorAt(Token& token, std::string msg, std::string note) {
     if (hadError) return;
     errorAtView(token.view, msg, note);
@@ -283,11 +324,13 @@ Expr Parser::post() {
     SourceView view = cur.view;
     Expr expr = primary();
 
-    while (match(TokenType::Dot, TokenType::LeftParen)) {
+    while (match(TokenType::Dot, TokenType::LeftParen, TokenType::LeftBracket)) {
         if (prev.type == TokenType::Dot) {
             consume(TokenType::Identifier, "Expected identifier name after '.'");
             Identifier prop = identifer();
             expr = PropertyExpr{view | prev.view, expr, prop};
+        } else if (prev.type == TokenType::LeftBracket) {
+            expr = subscript(view, expr);
         } else {
             std::vector<Expr> args;
             if (!check(TokenType::RightParen)) {
@@ -322,9 +365,18 @@ Expr Parser::primary() {
         case TokenType::String:
             return string();
 
+        case TokenType::FormatString:
+            return formatString();
+
         case TokenType::LeftParen:
             return grouping();
 
+        case TokenType::LeftBracket:
+            return list();
+
+        case TokenType::LeftBrace:
+            return dict();
+
         default:
             errorAt(prev, "Expected an expression");
             return Empty{};
@@ -342,6 +394,61 @@ StrLiteral Parser::string() {
     return StrLiteral{prev.view, std::string(prev.value.data() + 1, prev.value.length() - 2)};
 }
 
+Expr Parser::formatString() {
+    SourceView view = prev.view;
+    const std::string& value = prev.value;
+    std::vector<Expr> parts;
+    std::string text;
+
+    // Skip the f and the quotes, doubled braces stand for themselves
+    size_t end = value.size() - 1;
+    for (size_t i = 2; i < end; i++) {
+        SourceView at = SourceView{view.index + (int)i, 1, view.line, view.column + (int)i};
+        if ((value[i] == '{' || value[i] == '}') && value[i + 1] == value[i]) {
+            text += value[i++];
+            continue;
+        }
+
+        if (value[i] == '}') {
+            errorAtView(at, "Unmatched '}' in format string", "Use '}}' for a literal brace");
+            return Empty{};
+        }
+
+        if (value[i] != '{') {
+            text += value[i];
+            continue;
+        }
+
+        size_t close = formatExpressionEnd(value, i);
+        if (close >= end) {
+            errorAtView(at, "Expected '}' to close format string expression");
+            return Empty{};
+        }
+
+        if (text.size()) {
+            parts.push_back(StrLiteral{view, std::move(text)});
+            text.clear();
+        }
+
+        SourceView range = SourceView{view.index + (int)i + 1, (int)(close - i - 1), view.line, view.column + (int)i + 1};
+        Parser parser = Parser(source, path, range);
+        parts.push_back(parser.parseExpression());
+        if (parser.failed()) {
+            hadError = true;
+            error = parser.getError();
+            return Empty{};
+        }
+
+        i = close;
+    }
+
+    if (text.size() || parts.empty()) {
+        parts.push_back(StrLiteral{view, std::move(text)});
+    }
+
+    return FormatExpr{view, std::move(parts)};
+}
+
 Identifier Parser::identifer() {
     return Identifier{prev.view, prev.value};
 }
@@ -352,6 +459,52 @@ Expr Parser::grouping() {
     return expr;
 }
 
+Expr Parser::list() {
+    SourceView view = prev.view;
+    std::vector<Expr> items;
+    if (!check(TokenType::RightBracket)) {
+        items = exprList();
+    }
+
+    consume(TokenType::RightBracket, "Expected ']' after list items");
+    return ListExpr{view | prev.view, items};
+}
+
+Expr Parser::dict() {
+    SourceView view = prev.view;
+    std::vector<Expr> keys;
+    std::vector<Expr> values;
+
+    while (!check(TokenType::RightBrace) && !isFinished()) {
+        keys.push_back(expression());
+        consume(TokenType::Colon, "Expected ':' after dict key");
+        values.push_back(expression());
+
+        if (!match(TokenType::Comma))
+            break;
+    }
+
+    consume(TokenType::RightBrace, "Expected '}' after dict entries");
+    return DictExpr{view | prev.view, keys, values};
+}
+
+Expr Parser::subscript(SourceView view, Expr& expr) {
+    Expr start = Empty{};
+    if (!check(TokenType::Colon)) {
+        start = expression();
+
+        if (!check(TokenType::Colon)) {
+            consume(TokenType::RightBracket, "Expected ']' after index");
+            return IndexExpr{view | prev.view, expr, start};
+        }
+    }
+
+    advance();
+    Expr end = check(TokenType::RightBracket) ? Expr(Empty{}) : expression();
+    consume(TokenType::RightBracket, "Expected ']' after slice");
+    return SliceExpr{view | prev.view, expr, start, end};
+}
+
 std::vector<Expr> Parser::exprList() {
     std::vector<Expr> values;
 
@@ -376,6 +529,63 @@ std::vector<Stmt> Parser::block() {
     return body;
 }
 
+void Parser::skipBlock() {
+    // Only brackets are checked here, the rest of the body is validated once it is parsed
+    std::vector<Token> open = {prev};
+
+    while (!isFinished()) {
+        if (check(TokenType::Identifier)) {
+            skippedNames.insert(cur.value);
+        } else if (check(TokenType::FormatString)) {
+            skipFormatString(cur);
+        } else if (check(TokenType::LeftBrace) || check(TokenType::LeftParen)) {
+            open.push_back(cur);
+        } else if (check(TokenType::RightBrace) || check(TokenType::RightParen)) {
+            TokenType expected = open.back().type == TokenType::LeftBrace ? TokenType::RightBrace : TokenType::RightParen;
+            if (cur.type != expected) {
+                errorAt(cur, formatStr("Expected '%p' to close '%s'", expected == TokenType::RightBrace ? "}" : ")", open.back().value));
+                return;
+            }
+
+            open.pop_back();
+            if (open.empty()) {
+                advance();
+                return;
+            }
+        }
+
+        advance();
+    }
+
+    errorAt(open.back(), "Unclosed bracket", "opened here");
+}
+
+void Parser::skipFormatString(Token& token) {
+    // The expressions inside are only scanned for the names they use
+    const std::string& value = token.value;
+    size_t end = value.size() - 1;
+    for (size_t i = 2; i < end; i++) {
+        if ((value[i] == '{' || value[i] == '}') && value[i + 1] == value[i]) {
+            i++;
+            continue;
+        }
+
+        if (value[i] != '{') continue;
+
+        size_t close = formatExpressionEnd(value, i);
+        if (close >= end) return;
+
+        for (Token& inner : Scanner(source, token.view.index + i + 1, token.view.index + close, token.view.line).scanAll()) {
+            if (inner.type == TokenType::Identifier) {
+                skippedNames.insert(inner.value);
+            } else if (inner.type == TokenType::FormatString) {
+                skipFormatString(inner);
+            }
+        }
+        i = close;
+    }
+}
+
 Stmt Parser::statement() {
     SourceView view = cur.view;
 
@@ -405,6 +615,7 @@ Stmt Parser::statement() {
             return funcDeclaration();
 
         case TokenType::Var:
+        case TokenType::Const:
             return varDeclaration();
 
         case TokenType::LeftBrace: {
@@ -531,7 +742,7 @@ Stmt Parser::typeDeclaration() {
     Identifier name = identifer();
     
     std::vector<Identifier> parents;
-    if (match(TokenType::Semicolon)) {
+    if (match(TokenType::Colon)) {
         do {
             consume(TokenType::Identifier, "Parent must by an identifier");
             parents.push_back(identifer());
@@ -549,7 +760,7 @@ Stmt Parser::typeDeclaration() {
     return TypeDeclaration{view | prev.view, name, parents, methods};
 }
 
-Stmt Parser::funcDeclaration() {
+Stmt Parser::funcDeclaration(bool preparse) {
     SourceView view = cur.view;
     advance();
     if (!match(TokenType::Identifier)) {
@@ -574,6 +785,17 @@ Stmt Parser::funcDeclaration() {
 
     consume(TokenType::RightParen, "Expected ')' after function arguments");
     consume(TokenType::LeftBrace, "Expected '{' before function body");
+
+    if (preparse) {
+        SourceView open = prev.view;
+        skipBlock();
+
+        FuncDeclaration decl = FuncDeclaration{view | prev.view, name, args};
+        decl.preparsed = true;
+        decl.bodyView = SourceView{open.index + 1, prev.view.index - open.index - 1, open.line, open.column + 1};
+        return decl;
+    }
+
     std::vector<Stmt> body = block();
     return FuncDeclaration{view | prev.view, name, args, body};
 }
@@ -603,11 +825,15 @@ Stmt Parser::methodDeclaration() {
     consume(TokenType::RightParen, "Expected ')' after method arguments");
     consume(TokenType::LeftBrace, "Expected '{' before method body");
     std::vector<Stmt> body = block();
-    return FuncDeclaration{view | prev.view, name, args, body};
+
+    FuncDeclaration decl = FuncDeclaration{view | prev.view, name, args, body};
+    decl.method = true;
+    return decl;
 }
 
 Stmt Parser::varDeclaration() {
     SourceView view = cur.view;
+    bool constant = cur.type == TokenType::Const;
     advance();
     if (!match(TokenType::Identifier)) {
         errorAt(cur, "Function name must be an identifier");
@@ -617,10 +843,13 @@ Stmt Parser::varDeclaration() {
     Expr expr;
     if (match(TokenType::Equal)) {
         expr = expression();
+    } else if (constant) {
+        errorAt(cur, "Expected '=' after constant name");
+        return Empty{};
     } else {
         expr = Empty{};
     }
-    Stmt stmt = VarDeclaration{view | prev.view, name, expr};
+    Stmt stmt = VarDeclaration{view | prev.view, name, expr, constant};
     consume(TokenType::Semicolon, "Expected ';' after variable declaration");
     return stmt;
 }
@@ -1,10 +1,22 @@
 #include "syntax/scanner.h"
+#include <algorithm>
+#include <cstring>
 #include "debug.h"
+#include "threadpool.h"
 
 Scanner::Scanner(std::string& src) : source(src) {
     line = 1;
     lineStart = source.data();
     current = source.data();
+    end = source.data() + strlen(source.c_str());
+}
+
+Scanner::Scanner(std::string& src, int begin, int end, int line) : line(line), source(src) {
+    current = source.data() + begin;
+    this->end = source.data() + end;
+
+    lineStart = current;
+    while (lineStart > source.data() && lineStart[-1] != '\n') lineStart--;
 }
 
 Token Scanner::nextToken() {
@@ -17,6 +29,7 @@ Token Scanner::nextToken() {
     char c = advance();
 
     if (isdigit(c)) return scanNumber();
+    if (c == 'f' && (peek() == '\"' || peek() == '\'')) return scanFormatString();
     if (isalpha(c) || c == '_') return scanIdentifer();
     if (c == '\"' || c == '\'') return scanString();
 
@@ -29,10 +42,16 @@ Token Scanner::nextToken() {
             return makeToken(TokenType::LeftBrace);
         case '}':
             return makeToken(TokenType::RightBrace);
+        case '[':
+            return makeToken(TokenType::LeftBracket);
+        case ']':
+            return makeToken(TokenType::RightBracket);
         case ',':
             return makeToken(TokenType::Comma);
         case ';':
             return makeToken(TokenType::Semicolon);
+        case ':':
+            return makeToken(TokenType::Colon);
         case '+':
             return makeToken(match('=') ? TokenType::PlusEqual : TokenType::Plus);
         case '-':
@@ -62,17 +81,29 @@ Token Scanner::nextToken() {
     }
 };
 
+std::vector<Token> Scanner::scanAll() {
+    std::vector<Token> tokens;
+
+    do {
+        tokens.push_back(nextToken());
+    } while (tokens.back().type != TokenType::EndOfFile);
+
+    return tokens;
+}
+
 char Scanner::advance() {
     current++;
     return current[-1];
 }
 
 char Scanner::peek() {
+    if (current >= end) return '\0';
+
     return *current;
 }
 
 char Scanner::peekNext() {
-    if (isAtEnd()) return '\0';
+    if (current + 1 >= end) return '\0';
 
     return current[1];
 }
@@ -149,6 +180,16 @@ Token Scanner::scanString() {
     return makeToken(TokenType::String);
 }
 
+Token Scanner::scanFormatString() {
+    advance();
+    Token token = scanString();
+    if (token.type == TokenType::String) {
+        token.type = TokenType::FormatString;
+    }
+
+    return token;
+}
+
 Token Scanner::scanIdentifer() {
     while (isalpha(peek()) || isdigit(peek()) || peek() == '_') advance();
 
@@ -184,6 +225,8 @@ Token Scanner::scanIdentifer() {
         token.type = TokenType::Func;
     } else if (token.value.compare("var") == 0) {
         token.type = TokenType::Var;
+    } else if (token.value.compare("const") == 0) {
+        token.type = TokenType::Const;
     } else if (token.value.compare("exit") == 0) {
         token.type = TokenType::Exit;
     } else if (token.value.compare("and") == 0) {
@@ -196,3 +239,82 @@ Token Scanner::scanIdentifer() {
 
     return token;
 }
+
+std::vector<Token> scanParallel(std::string& src) {
+    int length = strlen(src.c_str());
+    ThreadPool& pool = ThreadPool::shared();
+
+    int chunkCount = std::min(pool.size() * 4, length / parallel_scan_min_chunk);
+    if (length < parallel_scan_threshold || chunkCount < 2) {
+        return Scanner(src).scanAll();
+    }
+
+    // No token can span a newline (strings error on one, comments end at one),
+    // so every line start is a safe place to split the source
+    std::vector<int> bounds = {0};
+    for (int i = 1; i < chunkCount; i++) {
+        const char* newline = (const char*)memchr(src.data() + i * (length / chunkCount), '\n', length - i * (length / chunkCount));
+        if (newline == nullptr) break;
+
+        int split = newline - src.data() + 1;
+        if (split > bounds.back() && split < length) {
+            bounds.push_back(split);
+        }
+    }
+    bounds.push_back(length);
+
+    std::vector<std::vector<Token>> chunks(bounds.size() - 1);
+    ThreadPool::Group group;
+    for (int i = 0; i < (signed)chunks.size(); i++) {
+        pool.submit(group, [&src, &bounds, &chunks, i] {
+            chunks[i] = Scanner(src, bounds[i], bounds[i + 1], 1).scanAll();
+        });
+    }
+    pool.wait(group);
+
+    // Every chunk was scanned starting at line 1, shift them by the lines before it
+    size_t total = 0;
+    for (auto& chunk : chunks) {
+        total += chunk.size() - 1;
+    }
+
+    std::vector<Token> tokens;
+    tokens.reserve(total + 1);
+
+    int lineOffset = 0;
+    for (int i = 0; i < (signed)chunks.size(); i++) {
+        auto& chunk = chunks[i];
+        int count = i == (signed)chunks.size() - 1 ? chunk.size() : chunk.size() - 1;
+
+        for (int j = 0; j < count; j++) {
+            chunk[j].view.line += lineOffset;
+            tokens.push_back(std::move(chunk[j]));
+        }
+
+        lineOffset += chunk.back().view.line - 1;
+    }
+
+    return tokens;
+}
+
+size_t formatExpressionEnd(const std::string& value, size_t open) {
+    // Find the closing brace, skipping braces inside nested strings
+    size_t end = value.size() - 1;
+    size_t close = open + 1;
+    int depth = 0;
+    char quote = 0;
+    for (; close < end; close++) {
+        char c = value[close];
+        if (quote) {
+            if (c == quote) quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}' && depth-- == 0) {
+            break;
+        }
+    }
+
+    return close;
+}
@@ -0,0 +1,134 @@
+#include "threadpool.h"
+
+// Index of the queue owned by the current thread, the last queue is shared by outside threads
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local int currentQueue = -1;
+
+ThreadPool::ThreadPool(int count) {
+    stopping = false;
+    queued = 0;
+
+    for (int i = 0; i <= count; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (int i = 0; i < count; i++) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    // Without real concurrency (or threads at all, e.g. emscripten) tasks run inline
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() : 0);
+    return pool;
+}
+
+int ThreadPool::size() {
+    return workers.size();
+}
+
+void ThreadPool::submit(Group& group, std::function<void()> task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+
+    int index = currentPool == this ? currentQueue : (int)workers.size();
+    group.pending++;
+
+    {
+        std::unique_lock<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(Task{std::move(task), &group});
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        queued++;
+    }
+
+    available.notify_one();
+}
+
+void ThreadPool::wait(Group& group) {
+    // The waiting thread helps out instead of sleeping while there is work left, a worker
+    // starts with its own queue. Tasks of other groups may run here too, they never wait on this one
+    int index = currentPool == this ? currentQueue : (int)workers.size();
+    Task task;
+    while (group.pending > 0) {
+        if (pop(index, task) || steal(index, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this, &group] { return group.pending == 0 || queued > 0; });
+    }
+}
+
+bool ThreadPool::pop(int index, Task& task) {
+    Queue& queue = *queues[index];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued--;
+    return true;
+}
+
+bool ThreadPool::steal(int index, Task& task) {
+    int count = queues.size();
+    for (int i = 1; i <= count; i++) {
+        Queue& queue = *queues[(index + i) % count];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::run(Task& task) {
+    Group& group = *task.group;
+    task.body();
+    task.body = nullptr;
+
+    if (--group.pending == 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.notify_all();
+    }
+}
+
+void ThreadPool::work(int index) {
+    currentPool = this;
+    currentQueue = index;
+
+    Task task;
+    for (;;) {
+        if (pop(index, task) || steal(index, task)) {
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] { return stopping || queued > 0; });
+
+        if (stopping && queued == 0) return;
+    }
+}
@@ -1,3 +1,6 @@
+#include "util.h"
+#include <charconv>
+#include <cmath>
 #include <cstdarg>
 #include <iomanip>
 #include <iostream>
@@ -135,3 +138,17 @@ std::string formatStr(const char* format, ...) {
     va_end(args);
     return result;
 }
+
+int formatNumber(double value, char* buffer) {
+    // Below 1e15 every whole number has an exact integer and prints without an exponent
+    if (std::abs(value) < 1e15 && value == (double)(i64)value && !(value == 0 && std::signbit(value))) {
+        return std::to_chars(buffer, buffer + number_chars_max, (i64)value).ptr - buffer;
+    }
+
+    return std::to_chars(buffer, buffer + number_chars_max, value).ptr - buffer;
+}
+
+std::string numberStr(double value) {
+    char buffer[number_chars_max];
+    return std::string(buffer, formatNumber(value, buffer));
+}
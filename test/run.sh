@@ -0,0 +1,50 @@
+#!/bin/bash
+# Runs every script in test/scripts under each compiler mode and compares the output with
+# name.expected, or with name.lazy.expected for lazy runs when a script needs its own
+# Usage: test/run.sh [path to jake-lang]
+
+bin=$(realpath "${1:-./build/jake-lang}")
+dir=$(dirname "$0")/scripts
+failed=0
+
+# Long jumps and the parallel scanner only kick in for sources far too large to keep in the tree
+generated=$(mktemp -d)
+trap 'rm -rf "$generated"' EXIT
+{
+    echo "var a = 0;"
+    echo "while a < 5 {"
+    for i in $(seq 10000); do echo "    a = a + 1;"; done
+    echo "}"
+    echo "func count(n) {"
+    echo "    var b = 0;"
+    echo "    while b < n {"
+    for i in $(seq 10000); do echo "        b = b + 1;"; done
+    echo "    }"
+    echo "    return b;"
+    echo "}"
+    echo "print a, count(5);"
+} > "$generated/large.jake"
+echo "10000 10000 " > "$generated/large.expected"
+
+for script in "$dir"/*.jake "$generated"/*.jake; do
+    name=${script%.jake}
+
+    for mode in "" --lazy --single-pass; do
+        expected=$name.expected
+        if [ "$mode" = --lazy ] && [ -f "$name.lazy.expected" ]; then
+            expected=$name.lazy.expected
+        fi
+
+        for level in -O0 -O1 -O2 -O3; do
+            output=$(cd "$(dirname "$script")" && "$bin" $mode $level "$(basename "$script")" 2>&1)
+            if [ "$output" != "$(cat "$expected")" ]; then
+                echo "FAIL $(basename "$script") $mode $level"
+                diff <(echo "$output") "$expected" | head -10
+                failed=1
+            fi
+        done
+    done
+done
+
+[ $failed = 0 ] && echo "All scripts passed"
+exit $failed